@@ -0,0 +1,237 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/*
+Epoch-based reclamation for any lock-free structure
+    epoch_domain& d = epoch_domain::global();
+    {
+        epoch_domain::guard g(d);   // nodes read from here on stay valid
+        node* n = head.load(std::memory_order_acquire);
+        ...
+        d.retire(unlinked);         // freed three epochs later
+    }
+- a global epoch counter; a thread entering a guard announces the epoch it
+  saw (pins), leaving the outermost guard unpins, no per-node work on reads
+- the epoch advances from e to e + 1 once every pinned thread has announced
+  e, so a thread still pinned in e - 1 holds it back
+- a node retired in epoch e was unlinked while the retiring thread was
+  pinned in e, the global epoch is then e or already e + 1, so threads that
+  can still reach it are pinned in e - 1, e or e + 1; once the epoch reached
+  e + 3 they all left their guards, the node can be freed
+- so three limbo lists per thread are enough, indexed by epoch % 3: the one
+  being filled and two that are waiting; when a thread sees a new epoch it
+  frees the lists that are three epochs old
+- a thread tries to advance the epoch every advance_interval retires
+- cheaper than hazard pointers on reads (one store and a fence per guard, not
+  per node), but a thread that stays pinned, or is preempted in a guard,
+  stops all reclamation: memory is unbounded
+- per-thread records are kept in a lock-free list that only grows, a record
+  is reused after its thread exited; the limbo lists of an exited thread are
+  handed to the domain and freed by a later advance
+- a domain must outlive the threads that used it
+*/
+class epoch_domain {
+    struct retired {
+        void* ptr;
+        void (*reclaim)(void*) noexcept;
+    };
+
+    struct limbo_list {
+        std::uint64_t epoch = 0;
+        std::vector<retired> nodes;
+    };
+
+    // a thread's state for this domain
+    struct record {
+        // epoch << 1 | 1 while pinned, 0 while not
+        alignas(64) std::atomic<std::uint64_t> state{0};
+        std::atomic<bool> in_use{true};
+        record* next = nullptr;
+
+        // owner only
+        unsigned int nesting = 0;
+        std::size_t retires_since_advance = 0;
+        limbo_list limbo[3];
+    };
+
+    struct local {
+        epoch_domain* domain;
+        record* rec;
+
+        ~local() {
+            domain->release_record(*rec);
+        }
+    };
+
+    // every domain the thread used, destroyed when the thread exits
+    struct registry {
+        std::vector<std::unique_ptr<local>> locals;
+        ~registry() { thread_exited = true; }
+    };
+    static inline thread_local registry thread_locals;
+    static inline thread_local bool thread_exited = false;
+
+    alignas(64) std::atomic<std::uint64_t> global_epoch{2};
+    alignas(64) std::atomic<record*> records{nullptr};
+
+    std::mutex orphans_lock;
+    std::vector<limbo_list> orphans;
+    std::atomic<bool> has_orphans{false};
+
+    record& get_record() {
+        auto& locals = thread_locals.locals;
+        for (auto const& l : locals) {
+            if (l->domain == this) return *l->rec;
+        }
+        record& r = acquire_record();
+        locals.push_back(std::make_unique<local>(this, &r));
+        return r;
+    }
+
+    record& acquire_record() {
+        for (record* r = records.load(std::memory_order_acquire); r; r = r->next) {
+            bool expected = false;
+            if (!r->in_use.load(std::memory_order_relaxed)
+                && r->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire))
+                return *r;
+        }
+        record* const r = new record;
+        r->next = records.load(std::memory_order_relaxed);
+        while (!records.compare_exchange_weak(r->next, r, std::memory_order_release, std::memory_order_relaxed));
+        return *r;
+    }
+
+    void release_record(record& r) {
+        std::vector<limbo_list> left;
+        for (auto& l : r.limbo) {
+            if (!l.nodes.empty()) left.push_back(std::exchange(l, {}));
+        }
+        if (!left.empty()) {
+            std::lock_guard lk(orphans_lock);
+            orphans.insert(orphans.end(), std::make_move_iterator(left.begin()), std::make_move_iterator(left.end()));
+            has_orphans.store(true, std::memory_order_release);
+        }
+        r.nesting = 0;
+        r.retires_since_advance = 0;
+        r.state.store(0, std::memory_order_release);
+        r.in_use.store(false, std::memory_order_release);
+    }
+
+    static void free_list(limbo_list& l) noexcept {
+        // a reclaim function may retire more nodes into another list
+        std::vector<retired> nodes = std::exchange(l.nodes, {});
+        for (retired const& r : nodes) r.reclaim(r.ptr);
+    }
+
+    // frees the lists of r that are at least three epochs older than e
+    static void collect(record& r, std::uint64_t e) noexcept {
+        for (auto& l : r.limbo) {
+            if (!l.nodes.empty() && l.epoch + 3 <= e) free_list(l);
+        }
+    }
+
+    void collect_orphans(std::uint64_t e) {
+        std::vector<limbo_list> ready;
+        {
+            std::lock_guard lk(orphans_lock);
+            auto const it = std::partition(orphans.begin(), orphans.end(),
+                                           [e](limbo_list const& l) { return l.epoch + 3 > e; });
+            ready.assign(std::make_move_iterator(it), std::make_move_iterator(orphans.end()));
+            orphans.erase(it, orphans.end());
+            has_orphans.store(!orphans.empty(), std::memory_order_relaxed);
+        }
+        for (auto& l : ready) free_list(l);
+    }
+
+    // e + 1 if every pinned thread announced e, false if one is behind
+    bool try_advance(std::uint64_t e) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        for (record* r = records.load(std::memory_order_acquire); r; r = r->next) {
+            // acquire: what a thread read before it unpinned happens before
+            // the nodes are freed
+            std::uint64_t const s = r->state.load(std::memory_order_acquire);
+            if ((s & 1) && (s >> 1) != e) return false;
+        }
+        return global_epoch.compare_exchange_strong(e, e + 1, std::memory_order_acq_rel, std::memory_order_relaxed);
+    }
+
+    void pin(record& r) {
+        if (r.nesting++) return;
+        std::uint64_t const e = global_epoch.load(std::memory_order_acquire);
+        r.state.store(e << 1 | 1, std::memory_order_relaxed);
+        // pairs with the fence in try_advance(): either the epoch can't pass
+        // e + 1 while this thread is pinned, or the pin is ordered after
+        // every unlink of the nodes that epoch frees
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        collect(r, e);
+        if (has_orphans.load(std::memory_order_acquire)) collect_orphans(e);
+    }
+
+    void unpin(record& r) noexcept {
+        if (--r.nesting) return;
+        r.state.store(0, std::memory_order_release);
+    }
+
+public:
+    static constexpr std::size_t advance_interval = 64;
+
+    // pins the calling thread for its lifetime, guards nest
+    class guard {
+        epoch_domain* domain;
+        record* rec;
+    public:
+        explicit guard(epoch_domain& d = epoch_domain::global()) : domain(&d), rec(&d.get_record()) {
+            domain->pin(*rec);
+        }
+        guard(guard const&) = delete;
+        guard& operator=(guard const&) = delete;
+        ~guard() { domain->unpin(*rec); }
+    };
+
+    epoch_domain() = default;
+    epoch_domain(epoch_domain const&) = delete;
+    epoch_domain& operator=(epoch_domain const&) = delete;
+    ~epoch_domain() {
+        if (!thread_exited)
+            std::erase_if(thread_locals.locals, [this](auto const& l) { return l->domain == this; });
+        for (auto& l : orphans) free_list(l);
+        for (record* r = records.load(std::memory_order_relaxed); r;) delete std::exchange(r, r->next);
+    }
+
+    static epoch_domain& global() {
+        static epoch_domain domain;
+        return domain;
+    }
+
+    // must be called inside a guard, p must be unreachable for threads that
+    // pin from now on; reclaim(p) is called three epochs later
+    void retire(void* p, void (*reclaim)(void*) noexcept) {
+        record& r = get_record();
+        std::uint64_t const e = r.state.load(std::memory_order_relaxed) >> 1;
+        limbo_list& l = r.limbo[e % 3];
+        // the list last held epoch e - 3 or older, which is free to go
+        if (l.epoch != e) {
+            free_list(l);
+            l.epoch = e;
+        }
+        l.nodes.push_back({p, reclaim});
+        if (++r.retires_since_advance >= advance_interval) {
+            r.retires_since_advance = 0;
+            try_advance(e);
+        }
+    }
+
+    template <typename T>
+    void retire(T* p) {
+        retire(static_cast<void*>(p), [](void* q) noexcept { delete static_cast<T*>(q); });
+    }
+
+    std::uint64_t epoch() const noexcept { return global_epoch.load(std::memory_order_relaxed); }
+};
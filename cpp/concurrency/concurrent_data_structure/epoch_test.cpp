@@ -0,0 +1,72 @@
+/*
+epoch_domain must not free a node while a reader pinned in the epoch after
+the retiring one can still hold it
+- W pins in 2 and retires advance_interval nodes, which advances the epoch
+  to 3 while W is still pinned in 2
+- R pins in 3 and could read N, W retires N in epoch 2 and unpins
+- R retires advance_interval nodes, the epoch advances to 4
+- W pins again in 4: N must still be alive, R is pinned in 3
+- every node is freed once the domain is destroyed
+
+build: g++ -std=c++20 -O2 -pthread epoch_test.cpp
+*/
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <semaphore>
+#include <thread>
+#include "epoch.hpp"
+
+std::atomic<bool> n_freed{false};
+std::atomic<std::size_t> num_freed{0};
+
+void reclaim_n(void*) noexcept { n_freed.store(true); }
+void reclaim_dummy(void* p) noexcept {
+    delete static_cast<int*>(p);
+    num_freed.fetch_add(1);
+}
+
+void retire_dummies(epoch_domain& d) {
+    for (std::size_t i = 0; i < epoch_domain::advance_interval; ++i) d.retire(new int, reclaim_dummy);
+}
+
+int main() {
+    int n = 0;
+    {
+        epoch_domain d;
+        std::binary_semaphore w_advanced{0}, r_pinned{0}, n_retired{0}, r_advanced{0}, w_checked{0};
+
+        std::jthread reader([&] {
+            w_advanced.acquire();
+            epoch_domain::guard g(d);
+            assert(d.epoch() == 3);
+            r_pinned.release();
+            n_retired.acquire();
+            retire_dummies(d);
+            assert(d.epoch() == 4);
+            r_advanced.release();
+            w_checked.acquire();
+        });
+
+        {
+            epoch_domain::guard g(d);
+            assert(d.epoch() == 2);
+            retire_dummies(d);
+            assert(d.epoch() == 3);
+            w_advanced.release();
+            r_pinned.acquire();
+            d.retire(&n, reclaim_n);
+        }
+        n_retired.release();
+        r_advanced.acquire();
+        {
+            epoch_domain::guard g(d);
+            assert(d.epoch() == 4);
+            assert(!n_freed.load());
+        }
+        w_checked.release();
+    }
+    assert(n_freed.load());
+    assert(num_freed.load() == 2 * epoch_domain::advance_interval);
+    std::puts("ok");
+}
@@ -0,0 +1,246 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/*
+Hazard pointers for any lock-free structure
+    hazard_pointer_domain& d = hazard_pointer_domain::global();
+    auto hp = d.make_hazard_pointer();
+    node* n = hp.protect(head);     // n can't be freed until hp is reset
+    ...
+    d.retire(unlinked);             // deleted once no hazard pointer holds it
+- slots are registered on demand and kept in a lock-free list that only
+  grows; a thread can hold as many hazard pointers as it wants, a released
+  slot goes to a per-thread cache and is handed back to the domain when the
+  thread exits
+- every thread retires into its own list, no atomics on retire; the list is
+  scanned only once it reaches twice the number of slots (at least
+  min_scan_threshold), so at least half of it is freed per scan
+- a scan copies the protected pointers into a sorted snapshot once and
+  binary searches it per retired node, instead of walking all slots for
+  every node: O(slots + retired) per scan, amortized O(1) hazard checks per
+  retire
+- nodes a thread still had retired when it exited are handed to the domain
+  and adopted by the next thread that scans
+- a domain must outlive the threads that used it; the destructor frees
+  whatever is still retired, so no hazard pointer may be alive then
+*/
+class hazard_pointer_domain {
+    struct slot {
+        std::atomic<void const*> ptr{nullptr};
+        std::atomic<bool> active{true};
+        slot* next = nullptr;
+    };
+
+    struct retired {
+        void* ptr;
+        void (*reclaim)(void*) noexcept;
+    };
+
+    // a thread's state for this domain
+    struct local {
+        hazard_pointer_domain* domain;
+        std::vector<slot*> free_slots;
+        std::vector<retired> retired_nodes;
+        std::vector<retired> scanning;      // reused by scan()
+        std::vector<void const*> snapshot;  // reused by scan()
+        bool in_scan = false;
+
+        ~local() {
+            for (slot* s : free_slots) s->active.store(false, std::memory_order_release);
+            if (!retired_nodes.empty()) domain->orphan(retired_nodes);
+        }
+    };
+
+    // every domain the thread used, destroyed when the thread exits
+    struct registry {
+        std::vector<std::unique_ptr<local>> locals;
+        ~registry() { thread_exited = true; }
+    };
+    static inline thread_local registry thread_locals;
+    // still readable after thread_locals is gone, e.g. when the global
+    // domain is destroyed after the main thread's thread_locals
+    static inline thread_local bool thread_exited = false;
+
+    std::atomic<slot*> slots{nullptr};
+    std::atomic<std::size_t> slot_count{0};
+
+    std::mutex orphans_lock;
+    std::vector<retired> orphans;
+    std::atomic<bool> has_orphans{false};
+
+    local& get_local() {
+        auto& locals = thread_locals.locals;
+        // a thread rarely uses more than one domain
+        for (auto const& l : locals) {
+            if (l->domain == this) return *l;
+        }
+        locals.push_back(std::make_unique<local>());
+        locals.back()->domain = this;
+        return *locals.back();
+    }
+
+    slot* acquire_slot(local& l) {
+        if (!l.free_slots.empty()) {
+            slot* const s = l.free_slots.back();
+            l.free_slots.pop_back();
+            return s;
+        }
+        // a slot given up by an exited thread
+        for (slot* s = slots.load(std::memory_order_acquire); s; s = s->next) {
+            bool expected = false;
+            if (!s->active.load(std::memory_order_relaxed)
+                && s->active.compare_exchange_strong(expected, true, std::memory_order_acquire))
+                return s;
+        }
+        slot* const s = new slot;
+        s->next = slots.load(std::memory_order_relaxed);
+        while (!slots.compare_exchange_weak(s->next, s, std::memory_order_release, std::memory_order_relaxed));
+        slot_count.fetch_add(1, std::memory_order_relaxed);
+        return s;
+    }
+
+    void orphan(std::vector<retired>& nodes) {
+        std::lock_guard lk(orphans_lock);
+        orphans.insert(orphans.end(), nodes.begin(), nodes.end());
+        has_orphans.store(true, std::memory_order_release);
+    }
+
+    std::size_t scan_threshold() const noexcept {
+        return std::max(2 * slot_count.load(std::memory_order_relaxed), min_scan_threshold);
+    }
+
+    void scan(local& l) {
+        // a reclaim function that retires more nodes must not start a
+        // nested scan on the buffers in use
+        if (l.in_scan) return;
+        l.in_scan = true;
+        if (has_orphans.load(std::memory_order_acquire)) {
+            std::lock_guard lk(orphans_lock);
+            l.retired_nodes.insert(l.retired_nodes.end(), orphans.begin(), orphans.end());
+            orphans.clear();
+            has_orphans.store(false, std::memory_order_relaxed);
+        }
+        l.scanning.swap(l.retired_nodes);
+
+        // pairs with the fence in protect(): either the protecting thread
+        // sees the node unlinked and retries, or the hazard is seen here
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        l.snapshot.clear();
+        for (slot* s = slots.load(std::memory_order_acquire); s; s = s->next) {
+            if (void const* p = s->ptr.load(std::memory_order_acquire)) l.snapshot.push_back(p);
+        }
+        std::sort(l.snapshot.begin(), l.snapshot.end());
+
+        for (retired const& r : l.scanning) {
+            if (std::binary_search(l.snapshot.begin(), l.snapshot.end(), r.ptr)) l.retired_nodes.push_back(r);
+            else r.reclaim(r.ptr);
+        }
+        l.scanning.clear();
+        l.in_scan = false;
+    }
+
+public:
+    static constexpr std::size_t min_scan_threshold = 64;
+
+    // one slot, owned by the thread that made it
+    class hazard_pointer {
+        friend class hazard_pointer_domain;
+        local* owner = nullptr;
+        slot* s = nullptr;
+
+        hazard_pointer(local* l, slot* sl) noexcept : owner(l), s(sl) {}
+
+    public:
+        hazard_pointer() = default;
+        hazard_pointer(hazard_pointer&& other) noexcept
+            : owner(std::exchange(other.owner, nullptr)), s(std::exchange(other.s, nullptr)) {}
+        hazard_pointer& operator=(hazard_pointer&& other) noexcept {
+            if (this != &other) {
+                release();
+                owner = std::exchange(other.owner, nullptr);
+                s = std::exchange(other.s, nullptr);
+            }
+            return *this;
+        }
+        ~hazard_pointer() { release(); }
+
+        bool empty() const noexcept { return s == nullptr; }
+
+        // protects the value of src, reloading until it didn't change
+        // while the protection was set
+        template <typename T>
+        T* protect(std::atomic<T*> const& src) noexcept {
+            T* p = src.load(std::memory_order_relaxed);
+            while (!try_protect(p, src));
+            return p;
+        }
+
+        // protects p if src still holds it, otherwise sets p to the new
+        // value and returns false
+        template <typename T>
+        bool try_protect(T*& p, std::atomic<T*> const& src) noexcept {
+            T* const old = p;
+            reset_protection(old);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            p = src.load(std::memory_order_acquire);
+            if (p == old) return true;
+            reset_protection();
+            return false;
+        }
+
+        void reset_protection(void const* p = nullptr) noexcept {
+            s->ptr.store(p, std::memory_order_release);
+        }
+
+    private:
+        void release() noexcept {
+            if (!s) return;
+            reset_protection();
+            owner->free_slots.push_back(s);
+            s = nullptr;
+        }
+    };
+
+    hazard_pointer_domain() = default;
+    hazard_pointer_domain(hazard_pointer_domain const&) = delete;
+    hazard_pointer_domain& operator=(hazard_pointer_domain const&) = delete;
+    ~hazard_pointer_domain() {
+        if (!thread_exited)
+            std::erase_if(thread_locals.locals, [this](auto const& l) { return l->domain == this; });
+        for (retired const& r : orphans) r.reclaim(r.ptr);
+        for (slot* s = slots.load(std::memory_order_relaxed); s;) delete std::exchange(s, s->next);
+    }
+
+    static hazard_pointer_domain& global() {
+        static hazard_pointer_domain domain;
+        return domain;
+    }
+
+    // may allocate a slot, use it on the calling thread only
+    hazard_pointer make_hazard_pointer() {
+        local& l = get_local();
+        return hazard_pointer(&l, acquire_slot(l));
+    }
+
+    // p must be unreachable for threads that didn't protect it yet;
+    // reclaim(p) is called once no hazard pointer holds it
+    void retire(void* p, void (*reclaim)(void*) noexcept) {
+        local& l = get_local();
+        l.retired_nodes.push_back({p, reclaim});
+        if (l.retired_nodes.size() >= scan_threshold()) scan(l);
+    }
+
+    template <typename T>
+    void retire(T* p) {
+        retire(static_cast<void*>(p), [](void* q) noexcept { delete static_cast<T*>(q); });
+    }
+
+    // scans the calling thread's retired nodes now
+    void reclaim() { scan(get_local()); }
+};
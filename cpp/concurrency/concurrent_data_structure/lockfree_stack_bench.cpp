@@ -0,0 +1,63 @@
+/*
+throughput of lockfree_stack with every memory reclamation scheme, 1 to 64
+threads
+- every thread pushes and pops in turn, so the stack stays short and every
+  pop retires a node
+- leak_reclaimer is the baseline: no reclamation work at all
+- atomic<shared_ptr> takes a lock inside libstdc++ and split reference counts
+  need a double-word CAS, hence -latomic
+
+build: g++ -std=c++20 -O2 -pthread lockfree_stack_bench.cpp -latomic
+*/
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <cstdio>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+#include "lockfree_stack_reclaimer.cpp"
+
+// these define their own lockfree_stack, their standard headers are already
+// included above
+namespace ref_count {
+#include "lockfree_stack_ref_count1.cpp"
+}
+namespace split_ref_count {
+#include "lockfree_stack_split_ref_count.cpp"
+}
+
+constexpr std::size_t num_ops = 1 << 20;
+
+template <typename Stack>
+double run(unsigned threads) {
+    Stack stack;
+    auto const start = std::chrono::steady_clock::now();
+    {
+        std::vector<std::jthread> workers;
+        for (unsigned t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t] {
+                for (std::size_t i = t; i < num_ops; i += threads) {
+                    stack.push(i);
+                    stack.pop();
+                }
+            });
+        }
+    }
+    std::chrono::duration<double> const elapsed = std::chrono::steady_clock::now() - start;
+    return num_ops / elapsed.count();
+}
+
+int main() {
+    std::printf("push+pop pairs/s\n");
+    std::printf("threads %12s %12s %12s %12s %12s\n", "leak", "shared_ptr", "split_ref", "hazard", "epoch");
+    for (unsigned threads : {1u, 2u, 4u, 8u, 16u, 32u, 64u}) {
+        std::printf("%7u %12.0f %12.0f %12.0f %12.0f %12.0f\n", threads,
+                    run<lockfree_stack<std::size_t, leak_reclaimer>>(threads),
+                    run<ref_count::lockfree_stack<std::size_t>>(threads),
+                    run<split_ref_count::lockfree_stack<std::size_t>>(threads),
+                    run<lockfree_stack<std::size_t, hazard_pointer_reclaimer>>(threads),
+                    run<lockfree_stack<std::size_t, epoch_reclaimer>>(threads));
+    }
+}
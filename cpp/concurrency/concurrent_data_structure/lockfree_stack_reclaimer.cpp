@@ -0,0 +1,102 @@
+#include <atomic>
+#include <optional>
+#include <concepts>
+#include <utility>
+#include "epoch.hpp"
+#include "hazard_pointer.hpp"
+
+/*
+lockfree_stack with the memory reclamation scheme as a policy
+- a Reclaimer provides
+    - `guard`: lives for one operation, `protect(src)` loads a pointer from
+      src that stays valid while the guard is alive
+    - `retire(p)`: called inside a guard with a node nobody can reach from
+      the stack anymore, deletes it once no guard can still use it
+- leak_reclaimer never deletes, hazard_pointer_reclaimer protects each node
+  read with a hazard pointer, epoch_reclaimer protects everything read
+  during the guard at the cost of one pin
+- the reference counting schemes change the node and the head themselves,
+  so they stay separate classes: lockfree_stack_ref_count1.cpp and
+  lockfree_stack_split_ref_count.cpp
+*/
+template <typename R>
+concept reclaimer = requires(typename R::guard& g, std::atomic<int*> const& src, int* p) {
+    { g.protect(src) } -> std::same_as<int*>;
+    R::retire(p);
+};
+
+struct leak_reclaimer {
+    struct guard {
+        template <typename T>
+        T* protect(std::atomic<T*> const& src) noexcept { return src.load(std::memory_order_acquire); }
+    };
+
+    template <typename T>
+    static void retire(T*) noexcept {}
+};
+
+struct hazard_pointer_reclaimer {
+    class guard {
+        hazard_pointer_domain::hazard_pointer hp = hazard_pointer_domain::global().make_hazard_pointer();
+    public:
+        // the previously protected pointer is given up
+        template <typename T>
+        T* protect(std::atomic<T*> const& src) noexcept { return hp.protect(src); }
+    };
+
+    template <typename T>
+    static void retire(T* p) { hazard_pointer_domain::global().retire(p); }
+};
+
+struct epoch_reclaimer {
+    struct guard {
+        epoch_domain::guard pin{epoch_domain::global()};
+
+        template <typename T>
+        T* protect(std::atomic<T*> const& src) noexcept { return src.load(std::memory_order_acquire); }
+    };
+
+    template <typename T>
+    static void retire(T* p) { epoch_domain::global().retire(p); }
+};
+
+template <typename T, reclaimer Reclaimer = epoch_reclaimer>
+  requires std::is_nothrow_move_constructible_v<T>
+class lockfree_stack {
+    struct node {
+        T data;
+        node* next;
+    };
+    std::atomic<node*> head{nullptr};
+public:
+    lockfree_stack() = default;
+    lockfree_stack(lockfree_stack const&) = delete;
+    lockfree_stack& operator=(lockfree_stack const&) = delete;
+    ~lockfree_stack() {
+        for (node* curr = head.load(); curr;) delete std::exchange(curr, curr->next);
+    }
+
+    void push(T const& data) {
+        node* new_node = new node{data, head.load(std::memory_order_relaxed)};
+        while (!head.compare_exchange_weak(new_node->next, new_node,
+                std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    std::optional<T> pop() {
+        typename Reclaimer::guard guard;
+        node* old_head;
+        // a failed CAS loads the new head into old_head, but only protect()
+        // makes it safe to dereference
+        do {
+            old_head = guard.protect(head);
+        } while (old_head && !head.compare_exchange_strong(old_head, old_head->next,
+                std::memory_order_acquire, std::memory_order_relaxed));
+
+        std::optional<T> res;
+        if (old_head) {
+            res.emplace(std::move(old_head->data));
+            Reclaimer::retire(old_head);
+        }
+        return res;
+    }
+};
@@ -14,7 +14,7 @@ private:
     std::atomic<std::shared_ptr<node>> head;
 public:
     void push(T const& data) {
-        std::shared_ptr<node> new_node = new node{data, head.load(std::memory_order_relaxed)};
+        std::shared_ptr<node> new_node(new node{data, head.load(std::memory_order_relaxed)});
         while (!head.compare_exchange_weak(new_node->next, new_node,
                 std::memory_order_release, std::memory_order_relaxed));
     }
@@ -12,6 +12,7 @@ private:
         // value of external_count does not matter if ptr == nullptr
         int external_count = 1; 
         node* ptr = nullptr;    // when stack is empty
+        counted_node_ptr() = default;
         counted_node_ptr(node* p) : ptr(p) {}
     };
     
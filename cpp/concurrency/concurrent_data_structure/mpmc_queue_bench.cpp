@@ -0,0 +1,71 @@
+/*
+throughput of bounded_mpmc_queue vs lockfree_queue, 1 to 64 threads
+- half of the threads push, half pop (one thread alternates push and pop),
+  every item is pushed once and popped once
+- lockfree_queue allocates twice per push and its atomic<shared_ptr> takes a
+  lock inside libstdc++; the bounded queue allocates nothing after construction
+
+build: g++ -std=c++20 -O2 -pthread -I../../c++20/coroutines mpmc_queue_bench.cpp
+*/
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include "mpmc_queue_bounded.cpp"
+#include "mpmc_queue_ref_count.cpp"
+
+constexpr std::size_t num_items = 1 << 20;
+
+struct bounded {
+    bounded_mpmc_queue<std::size_t> q{1024};
+    bool try_push(std::size_t x) { return q.try_push(x); }
+    bool try_pop() { return q.try_pop().has_value(); }
+};
+
+struct ref_count {
+    lockfree_queue<std::size_t> q;
+    bool try_push(std::size_t x) { q.push(x); return true; }
+    bool try_pop() { return q.pop() != nullptr; }
+};
+
+template <typename Queue>
+double run(unsigned threads) {
+    Queue queue;
+    std::atomic<std::size_t> popped{0};
+    auto const start = std::chrono::steady_clock::now();
+    {
+        std::vector<std::jthread> workers;
+        if (threads == 1) {
+            for (std::size_t i = 0; i < num_items; ++i) {
+                queue.try_push(i);
+                queue.try_pop();
+            }
+        }
+        unsigned const producers = threads / 2;
+        for (unsigned p = 0; p < producers; ++p) {
+            workers.emplace_back([&, p] {
+                for (std::size_t i = p; i < num_items; i += producers) {
+                    while (!queue.try_push(i)) std::this_thread::yield();
+                }
+            });
+        }
+        for (unsigned c = producers; c < threads && threads > 1; ++c) {
+            workers.emplace_back([&] {
+                while (popped.load(std::memory_order_relaxed) < num_items) {
+                    if (queue.try_pop()) popped.fetch_add(1, std::memory_order_relaxed);
+                    else std::this_thread::yield();
+                }
+            });
+        }
+    }
+    std::chrono::duration<double> const elapsed = std::chrono::steady_clock::now() - start;
+    return num_items / elapsed.count();
+}
+
+int main() {
+    for (unsigned threads : {1u, 2u, 4u, 8u, 16u, 32u, 64u}) {
+        std::printf("%2u threads  bounded_mpmc_queue %12.0f items/s  lockfree_queue %12.0f items/s\n",
+                    threads, run<bounded>(threads), run<ref_count>(threads));
+    }
+}
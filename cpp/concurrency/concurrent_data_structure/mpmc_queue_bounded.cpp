@@ -0,0 +1,165 @@
+#include "manual_lifetime.hpp"
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <type_traits>
+
+/*
+Bounded multiple-producer, multiple-consumer queue (Dmitry Vyukov's array
+based queue)
+- every cell carries a sequence number saying whose turn it is:
+    - seq == pos: free, the producer claiming position pos may write it
+    - seq == pos + 1: filled, the consumer claiming position pos may read it
+    - after the read, seq = pos + capacity, the cell is free for the next lap
+- try_push/try_pop claim a position with one CAS on enqueue_pos/dequeue_pos,
+  only if the cell at that position is ready, so they never wait
+- push/pop take a position unconditionally (fetch_add) and then wait on the
+  cell's seq with C++20 atomic wait, the ticket variant of the same protocol
+- a blocking push/pop that has to wait registers in `waiters` first, seq is
+  only notified while it is nonzero: with no blocking caller waiting, an
+  operation pays no notify_all(), which for a 64-bit seq goes through the
+  shared waiter table of libstdc++
+- elements are constructed in place in the cells, nothing is allocated after
+  construction; head and tail are on separate cache lines
+- not strictly lock-free: a producer preempted between claiming a position
+  and publishing seq holds up consumers of that cell
+*/
+template <typename T>
+    requires std::is_nothrow_move_constructible_v<T>
+class bounded_mpmc_queue {
+    struct cell {
+        std::atomic<std::size_t> seq;
+        manual_lifetime<T> data;
+    };
+
+    std::size_t const mask;
+    std::unique_ptr<cell[]> const cells;
+    alignas(64) std::atomic<std::size_t> enqueue_pos{0};
+    alignas(64) std::atomic<std::size_t> dequeue_pos{0};
+    alignas(64) std::atomic<std::size_t> waiters{0};
+
+    // the seq_cst store and load pair with those in wait_for(): either the
+    // waiter sees the new seq or this sees the waiter
+    void publish(cell& c, std::size_t seq) noexcept {
+        c.seq.store(seq, std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_seq_cst)) c.seq.notify_all();
+    }
+
+    void wait_for(cell& c, std::size_t want) noexcept {
+        std::size_t seq = c.seq.load(std::memory_order_acquire);
+        if (seq == want) return;
+        waiters.fetch_add(1, std::memory_order_seq_cst);
+        while ((seq = c.seq.load(std::memory_order_seq_cst)) != want)
+            c.seq.wait(seq, std::memory_order_acquire);
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    template <typename... Args>
+    void fill(cell& c, std::size_t pos, Args&&... args) {
+        c.data.construct_from([&] { return T(std::forward<Args>(args)...); });
+        publish(c, pos + 1);
+    }
+
+    T drain(cell& c, std::size_t pos) noexcept {
+        T res(std::move(c.data.get()));
+        c.data.destroy();
+        publish(c, pos + mask + 1);
+        return res;
+    }
+
+public:
+    // capacity is rounded up to a power of 2
+    explicit bounded_mpmc_queue(std::size_t capacity)
+        : mask(std::bit_ceil(capacity < 2 ? 2 : capacity) - 1), cells(new cell[mask + 1]) {
+        for (std::size_t i = 0; i <= mask; ++i) cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+    bounded_mpmc_queue(bounded_mpmc_queue const&) = delete;
+    bounded_mpmc_queue& operator=(bounded_mpmc_queue const&) = delete;
+    ~bounded_mpmc_queue() { while (try_pop()); }
+
+    template <typename... Args>
+    bool try_emplace(Args&&... args) {
+        // a claimed cell must be published, so a constructor that may throw
+        // runs before the claim and the element is moved in
+        if constexpr (!std::is_nothrow_constructible_v<T, Args&&...>)
+            return try_emplace(T(std::forward<Args>(args)...));
+        std::size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+        while (true) {
+            cell& c = cells[pos & mask];
+            std::size_t const seq = c.seq.load(std::memory_order_acquire);
+            auto const diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    fill(c, pos, std::forward<Args>(args)...);
+                    return true;
+                }
+            }
+            else if (diff < 0) {
+                // the cell still holds the element from the previous lap
+                return false;
+            }
+            else {
+                // another producer took pos
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool try_push(T const& data) { return try_emplace(data); }
+    bool try_push(T&& data) { return try_emplace(std::move(data)); }
+
+    std::optional<T> try_pop() noexcept {
+        std::size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        while (true) {
+            cell& c = cells[pos & mask];
+            std::size_t const seq = c.seq.load(std::memory_order_acquire);
+            auto const diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    return std::optional<T>(drain(c, pos));
+                }
+            }
+            else if (diff < 0) {
+                return std::nullopt;    // empty
+            }
+            else {
+                pos = dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // blocks while the queue is full
+    template <typename... Args>
+    void emplace(Args&&... args) {
+        if constexpr (!std::is_nothrow_constructible_v<T, Args&&...>)
+            return emplace(T(std::forward<Args>(args)...));
+        std::size_t const pos = enqueue_pos.fetch_add(1, std::memory_order_relaxed);
+        cell& c = cells[pos & mask];
+        wait_for(c, pos);
+        fill(c, pos, std::forward<Args>(args)...);
+    }
+
+    void push(T const& data) { emplace(data); }
+    void push(T&& data) { emplace(std::move(data)); }
+
+    // blocks while the queue is empty; the position is taken on entry, so
+    // a pop that is waiting can't give up
+    T pop() noexcept {
+        std::size_t const pos = dequeue_pos.fetch_add(1, std::memory_order_relaxed);
+        cell& c = cells[pos & mask];
+        wait_for(c, pos + 1);
+        return drain(c, pos);
+    }
+
+    std::size_t capacity() const noexcept { return mask + 1; }
+
+    // approximate while other threads push or pop
+    std::size_t size() const noexcept {
+        std::size_t const e = enqueue_pos.load(std::memory_order_relaxed);
+        std::size_t const d = dequeue_pos.load(std::memory_order_relaxed);
+        return e > d ? e - d : 0;
+    }
+};
@@ -0,0 +1,139 @@
+#include "manual_lifetime.hpp"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+
+/*
+Bounded single-producer, single-consumer wait-free ring
+- fixed power-of-2 capacity, slots are allocated once, elements are
+  constructed in place by the producer and destroyed in place by the consumer
+- each side keeps a plain copy of the other side's index and only reloads the
+  atomic when the copy says full (producer) or empty (consumer), so in steady
+  state a push or pop touches no cache line written by the other thread
+- producer line: tail + cached_head, consumer line: head + cached_tail
+- front()/pop() let the consumer use an element where it is instead of moving
+  it out, push_n/pop_n publish a whole batch with one store
+*/
+template <typename T>
+    requires std::is_nothrow_destructible_v<T>
+class bounded_spsc_queue {
+    std::size_t const mask;
+    std::unique_ptr<manual_lifetime<T>[]> const slots;
+
+    // written by the producer
+    alignas(64) std::atomic<std::size_t> tail{0};
+    std::size_t cached_head = 0;
+
+    // written by the consumer
+    alignas(64) std::atomic<std::size_t> head{0};
+    std::size_t cached_tail = 0;
+
+    // producer side: free slots, reloading head only if fewer than wanted
+    std::size_t free_slots(std::size_t t, std::size_t wanted) noexcept {
+        std::size_t free = capacity() - (t - cached_head);
+        if (free < wanted) {
+            cached_head = head.load(std::memory_order_acquire);
+            free = capacity() - (t - cached_head);
+        }
+        return free;
+    }
+
+    // consumer side: filled slots, reloading tail only if fewer than wanted
+    std::size_t filled_slots(std::size_t h, std::size_t wanted) noexcept {
+        std::size_t filled = cached_tail - h;
+        if (filled < wanted) {
+            cached_tail = tail.load(std::memory_order_acquire);
+            filled = cached_tail - h;
+        }
+        return filled;
+    }
+
+public:
+    // capacity is rounded up to a power of 2
+    explicit bounded_spsc_queue(std::size_t capacity)
+        : mask(std::bit_ceil(capacity < 2 ? 2 : capacity) - 1),
+          slots(new manual_lifetime<T>[mask + 1]) {}
+    bounded_spsc_queue(bounded_spsc_queue const&) = delete;
+    bounded_spsc_queue& operator=(bounded_spsc_queue const&) = delete;
+    ~bounded_spsc_queue() {
+        while (front()) pop();
+    }
+
+    std::size_t capacity() const noexcept { return mask + 1; }
+
+    // producer
+
+    template <typename... Args>
+    bool try_emplace(Args&&... args) {
+        std::size_t const t = tail.load(std::memory_order_relaxed);
+        if (free_slots(t, 1) == 0) return false;
+        slots[t & mask].construct_from([&] { return T(std::forward<Args>(args)...); });
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_push(T const& data) { return try_emplace(data); }
+    bool try_push(T&& data) { return try_emplace(std::move(data)); }
+
+    // copies up to n elements from first (use std::make_move_iterator to
+    // move them), returns how many; they become visible together
+    template <typename InputIt>
+    std::size_t push_n(InputIt first, std::size_t n) {
+        std::size_t const t = tail.load(std::memory_order_relaxed);
+        std::size_t const k = std::min(n, free_slots(t, n));
+        std::size_t i = 0;
+        try {
+            for (; i < k; ++i, ++first) slots[(t + i) & mask].construct_from([&] { return T(*first); });
+        }
+        catch (...) {
+            // publish what was constructed
+            tail.store(t + i, std::memory_order_release);
+            throw;
+        }
+        tail.store(t + k, std::memory_order_release);
+        return k;
+    }
+
+    // consumer
+
+    // oldest element or nullptr if empty, valid until pop()
+    T* front() noexcept {
+        std::size_t const h = head.load(std::memory_order_relaxed);
+        if (filled_slots(h, 1) == 0) return nullptr;
+        return &slots[h & mask].get();
+    }
+
+    // destroys the front element, the queue must not be empty
+    void pop() noexcept {
+        std::size_t const h = head.load(std::memory_order_relaxed);
+        slots[h & mask].destroy();
+        head.store(h + 1, std::memory_order_release);
+    }
+
+    // moves up to n elements to out, returns how many; the slots are handed
+    // back to the producer together
+    template <typename OutputIt>
+        requires std::is_nothrow_move_constructible_v<T>
+    std::size_t pop_n(OutputIt out, std::size_t n) {
+        std::size_t const h = head.load(std::memory_order_relaxed);
+        std::size_t const k = std::min(n, filled_slots(h, n));
+        for (std::size_t i = 0; i < k; ++i, ++out) {
+            auto& slot = slots[(h + i) & mask];
+            *out = std::move(slot.get());
+            slot.destroy();
+        }
+        head.store(h + k, std::memory_order_release);
+        return k;
+    }
+
+    // approximate unless called by the producer or the consumer while the
+    // other side is idle
+    std::size_t size() const noexcept {
+        // head first, so that the tail read after it can't be smaller
+        std::size_t const h = head.load(std::memory_order_acquire);
+        return tail.load(std::memory_order_acquire) - h;
+    }
+};
@@ -0,0 +1,99 @@
+#include "manual_lifetime.hpp"
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+/*
+Unbounded single-producer, single-consumer queue made of fixed-size segments
+- the elements live in arrays of SegmentSize slots linked into a list, a
+  segment costs one allocation and one `next` pointer for SegmentSize
+  elements, so memory per element approaches sizeof(T)
+- the producer publishes elements by storing the total count pushed (`tail`),
+  the consumer reloads it only when its cached copy says empty
+- a segment the consumer has drained goes to a one-slot cache (`spare`), the
+  producer takes it from there before allocating a new one, so as long as the
+  consumer keeps up, the allocator is never called; if the cache is already
+  full the older segment is freed
+- the producer links a new segment before publishing an element in it, so a
+  consumer that saw the element can follow `next` without synchronization
+*/
+template <typename T, std::size_t SegmentSize = 1024>
+    requires std::is_nothrow_move_constructible_v<T> && (SegmentSize > 0)
+class segmented_spsc_queue {
+    struct segment {
+        manual_lifetime<T> slots[SegmentSize];
+        segment* next = nullptr;
+    };
+
+    // producer
+    alignas(64) std::atomic<std::size_t> tail{0};
+    segment* tail_segment;
+    std::size_t tail_slot = 0;
+
+    // consumer
+    alignas(64) std::size_t head = 0;
+    std::size_t cached_tail = 0;
+    segment* head_segment;
+    std::size_t head_slot = 0;
+
+    alignas(64) std::atomic<segment*> spare{nullptr};
+
+    segment* new_segment() {
+        if (segment* s = spare.exchange(nullptr, std::memory_order_acquire)) {
+            s->next = nullptr;
+            return s;
+        }
+        return new segment;
+    }
+
+    void recycle(segment* s) noexcept {
+        delete spare.exchange(s, std::memory_order_acq_rel);
+    }
+
+public:
+    segmented_spsc_queue() : tail_segment(new segment), head_segment(tail_segment) {}
+    segmented_spsc_queue(segmented_spsc_queue const&) = delete;
+    segmented_spsc_queue& operator=(segmented_spsc_queue const&) = delete;
+    ~segmented_spsc_queue() {
+        while (pop());
+        for (segment* s = head_segment; s;) delete std::exchange(s, s->next);
+        delete spare.load(std::memory_order_relaxed);
+    }
+
+    template <typename... Args>
+    void emplace(Args&&... args) {
+        if (tail_slot == SegmentSize) {
+            segment* s = new_segment();
+            tail_segment->next = s;
+            tail_segment = s;
+            tail_slot = 0;
+        }
+        tail_segment->slots[tail_slot].construct_from([&] { return T(std::forward<Args>(args)...); });
+        ++tail_slot;
+        tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    void push(T data) { emplace(std::move(data)); }
+
+    std::optional<T> pop() {
+        std::optional<T> res;
+        if (head == cached_tail) {
+            cached_tail = tail.load(std::memory_order_acquire);
+            if (head == cached_tail) return res;
+        }
+        if (head_slot == SegmentSize) {
+            segment* const drained = head_segment;
+            head_segment = drained->next;
+            head_slot = 0;
+            recycle(drained);
+        }
+        auto& slot = head_segment->slots[head_slot];
+        res.emplace(std::move(slot.get()));
+        slot.destroy();
+        ++head_slot;
+        ++head;
+        return res;
+    }
+};
@@ -0,0 +1,101 @@
+/*
+parallel_algorithms.hpp against serial std:: algorithms and std::execution::par
+- sizes from 1M elements up to argv[1] (default 100M, 1000000000 for 1B,
+  which needs about 16GB for the sort buffer)
+- libstdc++ runs std::execution::par on TBB, without -ltbb (or without the
+  TBB headers) it silently falls back to serial
+
+build: g++ -std=c++20 -O2 -pthread algorithms_bench.cpp -ltbb
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <execution>
+#include <numeric>
+#include <random>
+#include <vector>
+#include "parallel_algorithms.hpp"
+
+template <class F>
+double millis(F&& f) {
+    auto const start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double, std::milli> const elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+void report(char const* algorithm, std::size_t n, double serial, double par, double pool) {
+    std::printf("%-18s %11zu  serial %9.1f ms  std::par %9.1f ms  pool %9.1f ms  (%.2fx vs serial)\n",
+                algorithm, n, serial, par, pool, serial / pool);
+}
+
+int main(int argc, char** argv) {
+    std::size_t const maxN = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100'000'000;
+    ThreadPool pool;
+    std::printf("%u workers\n", pool.numWorkers());
+    std::mt19937_64 rng(42);
+    std::int64_t sink = 0;
+
+    for (std::size_t n = 1'000'000; n <= maxN; n *= 10) {
+        std::vector<std::int64_t> data(n);
+        for (auto& x : data) x = static_cast<std::int64_t>(rng() % 1'000'000);
+        std::vector<std::int64_t> out(n);
+
+        {
+            std::int64_t a = 0, b = 0, c = 0;
+            double const s = millis([&] { a = std::reduce(data.begin(), data.end(), std::int64_t{0}); });
+            double const p = millis([&] {
+                b = std::reduce(std::execution::par, data.begin(), data.end(), std::int64_t{0});
+            });
+            double const t = millis([&] { c = parallel_reduce(pool, data, std::int64_t{0}); });
+            report("reduce", n, s, p, t);
+            sink += a + b + c;
+        }
+        {
+            auto square = [](std::int64_t x) { return x * x; };
+            std::int64_t a = 0, b = 0, c = 0;
+            double const s = millis([&] {
+                a = std::transform_reduce(data.begin(), data.end(), std::int64_t{0}, std::plus<>{}, square);
+            });
+            double const p = millis([&] {
+                b = std::transform_reduce(std::execution::par, data.begin(), data.end(), std::int64_t{0},
+                                          std::plus<>{}, square);
+            });
+            double const t = millis([&] {
+                c = parallel_transform_reduce(pool, data, std::int64_t{0}, std::plus<>{}, square);
+            });
+            report("transform_reduce", n, s, p, t);
+            sink += a + b + c;
+        }
+        {
+            double const s = millis([&] { std::inclusive_scan(data.begin(), data.end(), out.begin()); });
+            double const p = millis([&] {
+                std::inclusive_scan(std::execution::par, data.begin(), data.end(), out.begin());
+            });
+            double const t = millis([&] { parallel_inclusive_scan(pool, data, out.begin()); });
+            report("inclusive_scan", n, s, p, t);
+            sink += out.back();
+        }
+        {
+            auto work = [](std::int64_t& x) { x = x * 2654435761 % 1'000'003; };
+            double const s = millis([&] { std::for_each(out.begin(), out.end(), work); });
+            double const p = millis([&] { std::for_each(std::execution::par, out.begin(), out.end(), work); });
+            double const t = millis([&] { parallel_for_each(pool, out, work); });
+            report("for_each", n, s, p, t);
+            sink += out.front();
+        }
+        {
+            std::vector<std::int64_t> copy = data;
+            double const s = millis([&] { std::sort(copy.begin(), copy.end()); });
+            copy = data;
+            double const p = millis([&] { std::sort(std::execution::par, copy.begin(), copy.end()); });
+            copy = data;
+            double const t = millis([&] { parallel_sort(pool, copy); });
+            report("sort", n, s, p, t);
+            if (!std::is_sorted(copy.begin(), copy.end())) std::printf("parallel_sort failed\n");
+        }
+    }
+    return sink == 42;
+}
@@ -0,0 +1,328 @@
+#pragma once
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "thread_pool.hpp"
+
+/*
+Futures with continuations on a ThreadPool, the future bind of
+cpp/monads/monads.md without ever blocking a thread
+    auto f = spawn(pool, [] { return load(); })
+                 .then([](Data d) { return parse(d); })
+                 .then([](Tree t) { return spawn(pool, ...); });   // flattened
+- async_state is the task_state of the task plus a continuation word:
+  0 (pending), `readyTag` (done) or the task_node to run once done; attaching
+  is one CAS from 0, completing is one exchange to `readyTag`, so whoever
+  comes second schedules the continuation, nothing is locked
+- the continuation is posted by the worker that completed the state, so it
+  lands in that worker's local deque, where it runs next with the result
+  still in cache, unless a thief takes it
+- then(f) consumes the future, f gets the value (nothing for void); an
+  exception skips f and propagates down the chain; if f returns an
+  async_future the result is unwrapped
+- when_all / when_any complete once all / one of their inputs did and hand
+  the (ready) input futures back, like std::experimental::when_all; their
+  counter / first index is the result state's `gate`, so a combinator
+  allocates nothing but its pooled state and one node per input
+- one continuation per state, futures are move-only
+*/
+template <class T>
+class async_future;
+
+template <class T>
+struct when_any_result {
+    std::size_t index;      // the input that completed first, -1 if there were none
+    std::vector<async_future<T>> futures;
+};
+
+/*
+Node for the glue between states (unwrapping, when_all, when_any): the
+callback runs in `release`, so it also runs if the pool drops the node on
+shutdown, and the states it feeds break their promise instead of never
+becoming ready
+*/
+template <class F>
+class ready_callback final : public task_node {
+    F f;
+
+    explicit ready_callback(F&& cb) : f(std::move(cb)) {
+        fn = unique_task([] {});
+        release = [](task_node* n) noexcept {
+            auto* self = static_cast<ready_callback*>(n);
+            self->f();
+            self->~ready_callback();
+            block_pool::deallocate(self, sizeof(ready_callback));
+        };
+    }
+
+public:
+    static task_node* create(F cb) {
+        void* mem = block_pool::allocate(sizeof(ready_callback));
+        try {
+            return ::new (mem) ready_callback(std::move(cb));
+        }
+        catch (...) {
+            block_pool::deallocate(mem, sizeof(ready_callback));
+            throw;
+        }
+    }
+};
+
+template <class F>
+task_node* make_ready_callback(F&& f) {
+    return ready_callback<std::decay_t<F>>::create(std::forward<F>(f));
+}
+
+template <class T>
+class async_state final : public task_state<T> {
+    static constexpr std::uintptr_t readyTag = 1;
+
+    ThreadPool* pool;
+    std::atomic<std::uintptr_t> continuation{0};
+
+public:
+    // bookkeeping of when_all (inputs left) and when_any (first input)
+    std::atomic<std::size_t> gate{0};
+
+private:
+
+    static void destroy_self(task_state<T>* base) noexcept {
+        auto* self = static_cast<async_state*>(base);
+        self->~async_state();
+        block_pool::deallocate(self, sizeof(async_state));
+    }
+
+    static void release_async(task_node* node) noexcept {
+        auto* self = static_cast<async_state*>(node);
+        self->finish_queued();
+        std::uintptr_t const next = self->continuation.exchange(readyTag, std::memory_order_acq_rel);
+        if (next != 0) self->pool->post(reinterpret_cast<task_node*>(next));
+        self->drop_ref();
+    }
+
+    explicit async_state(ThreadPool& p) noexcept : task_state<T>(&destroy_self), pool(&p) {
+        this->release = &release_async;
+    }
+
+    // passes the state to f when Gated, for combinators that read `gate`
+    template <bool Gated, class F>
+    static async_state* make(ThreadPool& p, F&& f) {
+        void* mem = block_pool::allocate(sizeof(async_state));
+        auto* s = ::new (mem) async_state(p);
+        try {
+            if constexpr (Gated)
+                s->fn = unique_task([s, f = std::forward<F>(f)]() mutable { s->invoke(f, *s); });
+            else
+                s->fn = unique_task([s, f = std::forward<F>(f)]() mutable { s->invoke(f); });
+        }
+        catch (...) {
+            s->~async_state();
+            block_pool::deallocate(mem, sizeof(async_state));
+            throw;
+        }
+        return s;
+    }
+
+public:
+    template <class F>
+    static async_state* create(ThreadPool& p, F&& f) {
+        return make<false>(p, std::forward<F>(f));
+    }
+
+    // f(state) computes the result, gate starts at `gate`
+    template <class F>
+    static async_state* create_gated(ThreadPool& p, std::size_t gate, F&& f) {
+        auto* s = make<true>(p, std::forward<F>(f));
+        s->gate.store(gate, std::memory_order_relaxed);
+        return s;
+    }
+
+    // extra references, for callbacks that may run after the future and the
+    // task let go of the state
+    void retain(std::size_t n) noexcept { this->refs.fetch_add(n, std::memory_order_relaxed); }
+    void release_ref() noexcept { this->drop_ref(); }
+
+    // post `next` once this state is ready, right away if it already is;
+    // at most one continuation per state
+    void attach(task_node* next) noexcept {
+        std::uintptr_t expected = 0;
+        if (continuation.compare_exchange_strong(expected, reinterpret_cast<std::uintptr_t>(next),
+                                                 std::memory_order_release, std::memory_order_acquire))
+            return;
+        pool->post(next);
+    }
+
+    ThreadPool& owner() const noexcept { return *pool; }
+
+    // ready states only
+    bool failed() const noexcept { return this->error != nullptr; }
+    auto& result() noexcept { return *this->value; }
+};
+
+template <class T>
+struct is_async_future : std::false_type {};
+template <class T>
+struct is_async_future<async_future<T>> : std::true_type {};
+
+template <class T, class F>
+struct then_result : std::invoke_result<F&, T> {};
+template <class F>
+struct then_result<void, F> : std::invoke_result<F&> {};
+
+template <class T>
+class async_future : public pool_future<T> {
+    template <class F>
+    auto then_value(F&& f) {
+        using Res = typename then_result<T, std::decay_t<F>>::type;
+        auto* prev = shared_state();
+        auto* next = async_state<Res>::create(prev->owner(),
+            [p = std::move(*this), f = std::forward<F>(f)]() mutable -> Res {
+                // p is ready, get() rethrows its exception without calling f
+                if constexpr (std::is_void_v<T>) {
+                    p.get();
+                    return std::invoke(f);
+                }
+                else {
+                    return std::invoke(f, p.get());
+                }
+            });
+        async_future<Res> res(next);
+        prev->attach(next);
+        return res;
+    }
+
+public:
+    using value_type = T;
+
+    async_future() noexcept = default;
+    explicit async_future(async_state<T>* s) noexcept : pool_future<T>(s) {}
+
+    // for combinators: the state stays alive as long as this future does
+    async_state<T>* shared_state() const noexcept { return static_cast<async_state<T>*>(this->state); }
+
+    // f(value) runs on the pool once this future is ready, consumes *this
+    template <class F>
+    auto then(F&& f) {
+        auto step = then_value(std::forward<F>(f));
+        using Step = typename decltype(step)::value_type;
+        if constexpr (!is_async_future<Step>::value) {
+            return step;
+        }
+        else {
+            // f returned a future: res is attached to it once step is ready,
+            // and takes its value through step when it runs
+            using Inner = typename Step::value_type;
+            auto* stepState = step.shared_state();
+            auto* res = async_state<Inner>::create(stepState->owner(),
+                [s = std::move(step)]() mutable -> Inner {
+                    auto inner = s.get();
+                    if (!inner.valid()) throw std::future_error(std::future_errc::no_state);
+                    return inner.get();
+                });
+            async_future<Inner> out(res);
+            stepState->attach(make_ready_callback([stepState, res] {
+                // step's future is held by res, which isn't posted yet; an
+                // empty inner future fails res when it runs
+                if (stepState->failed() || !stepState->result().valid()) stepState->owner().post(res);
+                else stepState->result().shared_state()->attach(res);
+            }));
+            return out;
+        }
+    }
+};
+
+// run f on the pool, the returned future supports then()
+template <class F>
+    requires std::invocable<std::decay_t<F>&>
+auto spawn(ThreadPool& pool, F&& f) -> async_future<std::invoke_result_t<std::decay_t<F>&>> {
+    using Res = std::invoke_result_t<std::decay_t<F>&>;
+    auto* state = async_state<Res>::create(pool, std::forward<F>(f));
+    async_future<Res> res(state);
+    pool.post(state);
+    return res;
+}
+
+// ready once every input is, holds the (ready) inputs
+template <class T>
+auto when_all(ThreadPool& pool, std::vector<async_future<T>> futures)
+    -> async_future<std::vector<async_future<T>>> {
+    using Res = std::vector<async_future<T>>;
+    std::vector<async_state<T>*> inputs;
+    inputs.reserve(futures.size());
+    for (auto& f : futures) inputs.push_back(f.shared_state());
+    auto* res = async_state<Res>::create_gated(pool, inputs.size(),
+        [fs = std::move(futures)](auto&) mutable { return std::move(fs); });
+    async_future<Res> out(res);
+    if (inputs.empty()) {
+        pool.post(res);
+        return out;
+    }
+    // the last input to complete posts res, res isn't released before that
+    for (auto* in : inputs) {
+        in->attach(make_ready_callback([res, &pool] {
+            if (res->gate.fetch_sub(1, std::memory_order_acq_rel) == 1) pool.post(res);
+        }));
+    }
+    return out;
+}
+
+template <class... Ts>
+auto when_all(ThreadPool& pool, async_future<Ts>... futures)
+    -> async_future<std::tuple<async_future<Ts>...>> {
+    using Res = std::tuple<async_future<Ts>...>;
+    auto inputs = std::tuple(futures.shared_state()...);
+    auto* res = async_state<Res>::create_gated(pool, sizeof...(Ts),
+        [fs = Res(std::move(futures)...)](auto&) mutable { return std::move(fs); });
+    async_future<Res> out(res);
+    if constexpr (sizeof...(Ts) == 0) {
+        pool.post(res);
+    }
+    else {
+        std::apply([&](auto*... in) {
+            (in->attach(make_ready_callback([res, &pool] {
+                if (res->gate.fetch_sub(1, std::memory_order_acq_rel) == 1) pool.post(res);
+            })), ...);
+        }, inputs);
+    }
+    return out;
+}
+
+// ready once the first input is, which `index` tells; the others may still
+// be running
+template <class T>
+auto when_any(ThreadPool& pool, std::vector<async_future<T>> futures)
+    -> async_future<when_any_result<T>> {
+    constexpr std::size_t none = static_cast<std::size_t>(-1);
+    std::vector<async_state<T>*> inputs;
+    inputs.reserve(futures.size());
+    for (auto& f : futures) inputs.push_back(f.shared_state());
+    // gate: none until the first input claims it with its index
+    auto* res = async_state<when_any_result<T>>::create_gated(pool, none,
+        [fs = std::move(futures)](auto& self) mutable {
+            // the index was written before res was posted
+            return when_any_result<T>{self.gate.load(std::memory_order_relaxed), std::move(fs)};
+        });
+    async_future<when_any_result<T>> out(res);
+    if (inputs.empty()) {
+        pool.post(res);
+        return out;
+    }
+    // the inputs that lose may complete after res was consumed and dropped,
+    // every callback holds a reference
+    res->retain(inputs.size());
+    for (std::size_t i = 0; i < inputs.size(); ++i) {
+        inputs[i]->attach(make_ready_callback([i, res, &pool] {
+            std::size_t expected = none;
+            if (res->gate.compare_exchange_strong(expected, i, std::memory_order_relaxed)) pool.post(res);
+            res->release_ref();
+        }));
+    }
+    return out;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <new>
+#include <utility>
+
+/*
+Per-thread free lists of fixed-size blocks for task states
+- a block freed by a thread goes to that thread's free list, whichever thread
+  allocated it, blocks are plain memory so they can migrate between threads
+- no synchronization at all: each thread only touches its own lists
+- each list is capped so that a thread that only frees (e.g. the thread
+  calling future.get() for tasks allocated by workers) doesn't hoard memory
+- requests bigger than the largest size class go to ::operator new
+*/
+class block_pool {
+    static constexpr std::array<std::size_t, 4> block_sizes{64, 128, 256, 512};
+    static constexpr std::size_t max_cached_blocks = 1024;
+
+    struct free_block { free_block* next; };
+
+    struct cache {
+        std::array<free_block*, block_sizes.size()> heads{};
+        std::array<std::size_t, block_sizes.size()> counts{};
+
+        ~cache() {
+            for (auto head : heads) {
+                while (head) ::operator delete(std::exchange(head, head->next));
+            }
+        }
+    };
+
+    static cache& local_cache() noexcept {
+        thread_local cache c;
+        return c;
+    }
+
+    static constexpr std::size_t size_class(std::size_t n) noexcept {
+        std::size_t i = 0;
+        while (i < block_sizes.size() && block_sizes[i] < n) ++i;
+        return i;
+    }
+
+public:
+    static void* allocate(std::size_t n) {
+        std::size_t const i = size_class(n);
+        if (i == block_sizes.size()) return ::operator new(n);
+        auto& c = local_cache();
+        if (free_block* b = c.heads[i]) {
+            c.heads[i] = b->next;
+            --c.counts[i];
+            return b;
+        }
+        return ::operator new(block_sizes[i]);
+    }
+
+    static void deallocate(void* p, std::size_t n) noexcept {
+        std::size_t const i = size_class(n);
+        if (i == block_sizes.size()) return ::operator delete(p);
+        auto& c = local_cache();
+        if (c.counts[i] == max_cached_blocks) return ::operator delete(p);
+        c.heads[i] = ::new (p) free_block{c.heads[i]};
+        ++c.counts[i];
+    }
+};
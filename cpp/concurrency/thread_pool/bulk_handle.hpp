@@ -0,0 +1,128 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <new>
+#include <utility>
+#include "block_pool.hpp"
+
+/*
+Shared completion state of ThreadPool::submit_bulk / parallel_for
+- `pending` counts iterations that have not finished, every chunk subtracts
+  its size once, so completion costs one RMW per chunk instead of one
+  future per iteration
+- the first exception is kept, later chunks skip their iterations but still
+  count down so that the handle becomes ready
+- refs: one for the running chunks (dropped by the chunk that finishes last),
+  one for the bulk_handle
+*/
+class bulk_state {
+    std::atomic<std::size_t> pending;
+    std::atomic<std::uint32_t> ready{0};
+    std::atomic<std::uint32_t> refs{2};
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+    void (*destroy)(bulk_state*) noexcept;
+
+    friend class bulk_handle;
+
+protected:
+    bulk_state(std::size_t n, void (*d)(bulk_state*) noexcept) : pending(n), destroy(d) {
+        if (n == 0) {
+            ready.store(1, std::memory_order_relaxed);
+            refs.store(1, std::memory_order_relaxed);
+        }
+    }
+    ~bulk_state() = default;
+
+    void drop_ref() noexcept {
+        if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) destroy(this);
+    }
+
+public:
+    bool cancelled() const noexcept { return failed.load(std::memory_order_relaxed); }
+
+    void fail(std::exception_ptr e) noexcept {
+        bool expected = false;
+        // published to the waiter by the release in complete()
+        if (failed.compare_exchange_strong(expected, true, std::memory_order_relaxed))
+            error = std::move(e);
+    }
+
+    void complete(std::size_t n) noexcept {
+        if (pending.fetch_sub(n, std::memory_order_acq_rel) == n) {
+            ready.store(1, std::memory_order_release);
+            ready.notify_all();
+            drop_ref();
+        }
+    }
+};
+
+// bulk_state plus the loop body shared by all chunks
+template <class F>
+class bulk_body : public bulk_state {
+    static void destroy_self(bulk_state* s) noexcept {
+        auto* self = static_cast<bulk_body*>(s);
+        self->~bulk_body();
+        block_pool::deallocate(self, sizeof(bulk_body));
+    }
+
+    template <class G>
+    bulk_body(std::size_t n, std::size_t g, G&& body)
+        : bulk_state(n, &destroy_self), grain(g), f(std::forward<G>(body)) {}
+
+public:
+    std::size_t const grain;
+    F const f;   // invoked concurrently by all chunks
+
+    template <class G>
+    static bulk_body* create(std::size_t n, std::size_t grain, G&& body) {
+        void* mem = block_pool::allocate(sizeof(bulk_body));
+        try {
+            return ::new (mem) bulk_body(n, grain, std::forward<G>(body));
+        }
+        catch (...) {
+            block_pool::deallocate(mem, sizeof(bulk_body));
+            throw;
+        }
+    }
+};
+
+// single completion handle for a whole bulk submission
+class bulk_handle {
+    bulk_state* state = nullptr;
+public:
+    bulk_handle() noexcept = default;
+    explicit bulk_handle(bulk_state* s) noexcept : state(s) {}
+    bulk_handle(bulk_handle&& other) noexcept : state(std::exchange(other.state, nullptr)) {}
+    bulk_handle& operator=(bulk_handle&& other) noexcept {
+        if (this != &other) {
+            if (state) state->drop_ref();
+            state = std::exchange(other.state, nullptr);
+        }
+        return *this;
+    }
+    ~bulk_handle() { if (state) state->drop_ref(); }
+
+    bool valid() const noexcept { return state != nullptr; }
+
+    bool is_ready() const noexcept {
+        return state->ready.load(std::memory_order_acquire);
+    }
+
+    void wait() const noexcept {
+        while (!state->ready.load(std::memory_order_acquire))
+            state->ready.wait(0, std::memory_order_acquire);
+    }
+
+    // rethrows the first exception thrown by the loop body
+    void get() {
+        wait();
+        struct drop_on_exit {
+            bulk_state* s;
+            ~drop_on_exit() { s->drop_ref(); }
+        } guard{std::exchange(state, nullptr)};
+        if (guard.s->error) std::rethrow_exception(guard.s->error);
+    }
+};
@@ -0,0 +1,143 @@
+#pragma once
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+/*
+CPU / cache / NUMA topology read from /sys/devices/system/cpu (Linux)
+- cpuN/topology/thread_siblings_list: hardware threads sharing a core (SMT)
+- cpuN/cache/indexK/{level,shared_cpu_list}: cpus sharing the L3
+- cpuN/nodeM: NUMA node of the cpu
+- each group is identified by the lowest cpu in its list, missing files (e.g.
+  inside some containers) put every cpu in one group, so the distance degrades
+  gracefully to "same group"
+- only cpus in the process affinity mask are used, taskset/cgroup limits are
+  respected
+*/
+
+// distance between two cpus, in the order a thief should prefer them
+enum class cpu_locality : std::uint8_t { smt, cache, node, remote, unknown };
+inline constexpr std::size_t num_cpu_localities = 5;
+
+class cpu_topology {
+public:
+    struct cpu {
+        int id;
+        int core;   // lowest SMT sibling
+        int l3;     // lowest cpu sharing the L3
+        int node;
+    };
+
+    static cpu_topology detect() {
+        cpu_topology res;
+        for (int id : allowed_cpus()) {
+            std::string const dir = "/sys/devices/system/cpu/cpu" + std::to_string(id);
+            cpu c{id, id, -1, 0};
+            if (auto siblings = parse_cpu_list(read_file(dir + "/topology/thread_siblings_list"));
+                !siblings.empty())
+                c.core = siblings.front();
+            c.l3 = shared_l3(dir);
+            c.node = numa_node(dir);
+            res.cpus.push_back(c);
+        }
+        // consecutive workers land on the same node / L3 / core
+        std::ranges::sort(res.cpus, {}, [](cpu const& c) {
+            return std::tuple(c.node, c.l3, c.core, c.id);
+        });
+        return res;
+    }
+
+    std::vector<cpu> const& all() const noexcept { return cpus; }
+    bool empty() const noexcept { return cpus.empty(); }
+
+    static cpu_locality distance(cpu const& a, cpu const& b) noexcept {
+        if (a.core == b.core) return cpu_locality::smt;
+        if (a.l3 == b.l3) return cpu_locality::cache;
+        if (a.node == b.node) return cpu_locality::node;
+        return cpu_locality::remote;
+    }
+
+    // pin the calling thread, returns false if not supported or rejected
+    static bool pin_current_thread(int cpuId) noexcept {
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpuId, &set);
+        return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+        return false;
+#endif
+    }
+
+private:
+    std::vector<cpu> cpus;
+
+    static std::string read_file(std::string const& path) {
+        std::ifstream in(path);
+        std::string line;
+        std::getline(in, line);
+        return line;
+    }
+
+    // "0-3,8,10-11" -> {0, 1, 2, 3, 8, 10, 11}
+    static std::vector<int> parse_cpu_list(std::string_view s) {
+        std::vector<int> res;
+        while (!s.empty()) {
+            auto const comma = s.find(',');
+            std::string_view item = s.substr(0, comma);
+            s = comma == s.npos ? std::string_view{} : s.substr(comma + 1);
+            int lo = 0, hi = 0;
+            auto const dash = item.find('-');
+            std::from_chars(item.data(), item.data() + item.size(), lo);
+            hi = lo;
+            if (dash != item.npos)
+                std::from_chars(item.data() + dash + 1, item.data() + item.size(), hi);
+            for (int i = lo; i <= hi; ++i) res.push_back(i);
+        }
+        return res;
+    }
+
+    static std::vector<int> allowed_cpus() {
+        std::vector<int> res;
+#ifdef __linux__
+        cpu_set_t set;
+        if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+            for (int i = 0; i < CPU_SETSIZE; ++i)
+                if (CPU_ISSET(i, &set)) res.push_back(i);
+        }
+#endif
+        return res;
+    }
+
+    static int shared_l3(std::string const& cpuDir) {
+        std::error_code ec;
+        for (auto const& entry : std::filesystem::directory_iterator(cpuDir + "/cache", ec)) {
+            if (!entry.path().filename().string().starts_with("index")) continue;
+            if (read_file(entry.path() / "level") != "3") continue;
+            auto shared = parse_cpu_list(read_file(entry.path() / "shared_cpu_list"));
+            if (!shared.empty()) return shared.front();
+        }
+        return -1;
+    }
+
+    static int numa_node(std::string const& cpuDir) {
+        std::error_code ec;
+        for (auto const& entry : std::filesystem::directory_iterator(cpuDir, ec)) {
+            std::string const name = entry.path().filename().string();
+            int node = 0;
+            if (name.starts_with("node") &&
+                std::from_chars(name.data() + 4, name.data() + name.size(), node).ec == std::errc{})
+                return node;
+        }
+        return 0;
+    }
+};
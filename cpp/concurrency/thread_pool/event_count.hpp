@@ -0,0 +1,60 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+/*
+Event count: lets a thread sleep until "something might have changed" without
+a mutex around the condition it checks (here: all task queues are empty)
+
+- waiter:
+    auto key = ec.prepare_wait();
+    if (condition is satisfied) { ec.cancel_wait(); ... }
+    else ec.wait(key);
+- notifier: make the condition satisfied, then ec.notify_one()
+
+- lost wake-up is impossible: both prepare_wait and notify_one execute a
+  seq_cst fence between their store and their load (Dekker pattern), so either
+  the notifier sees the waiter or the waiter sees the new condition
+- if the notifier bumps epoch after the waiter reads key, wait(key) returns
+  immediately
+- epoch is a 32-bit word so that std::atomic::wait maps directly to a futex,
+  and notify_one costs only a load when nobody is sleeping
+*/
+class event_count {
+    std::atomic<std::uint32_t> epoch{0};
+    std::atomic<std::uint32_t> waiters{0};
+public:
+    event_count() = default;
+    event_count(event_count const&) = delete;
+    event_count& operator=(event_count const&) = delete;
+
+    std::uint32_t prepare_wait() noexcept {
+        waiters.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return epoch.load(std::memory_order_acquire);
+    }
+
+    void cancel_wait() noexcept {
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void wait(std::uint32_t key) noexcept {
+        // atomic::wait only returns once epoch != key
+        epoch.wait(key, std::memory_order_acquire);
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void notify_one() noexcept {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_relaxed) == 0) return;
+        epoch.fetch_add(1, std::memory_order_release);
+        epoch.notify_one();
+    }
+
+    void notify_all() noexcept {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_relaxed) == 0) return;
+        epoch.fetch_add(1, std::memory_order_release);
+        epoch.notify_all();
+    }
+};
@@ -0,0 +1,260 @@
+#pragma once
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include "block_pool.hpp"
+#include "thread_pool.hpp"
+
+/*
+Cilk-style fork/join on ThreadPool workers, with continuation stealing
+    fork_task<long> fib(int n) {
+        if (n < 2) co_return n;
+        auto a = fib(n - 1);
+        co_await fork(a);           // runs a now, the rest of fib may be stolen
+        long const b = co_await fib(n - 2);     // plain call
+        co_await join();            // a is done after this
+        co_return a.get() + b;
+    }
+    long r = sync_wait(pool, fib(30));
+- the same protocol as the task type in cpp/c++20/coroutines/task.hpp: a lazy
+  coroutine whose final_suspend transfers to whoever awaits it, with a fork
+  that publishes the awaiting coroutine before the transfer
+- work first: fork pushes the parent's handle onto the worker's deque (the
+  bare handle, no allocation) and resumes the child right away; when the
+  child is done it pops the parent back and resumes it, unless a thief took
+  it, so an unstolen fork costs a push, a pop and two atomic RMWs
+- waiting on children never blocks or helps on the stack: join suspends the
+  parent and its last child resumes it, on whatever worker that child ran;
+  all transfers are symmetric, so the stack stays flat however deep the
+  recursion, and the frames (from block_pool) are those on the path being
+  executed plus the stolen ones
+- `joins` counts the forked children still running plus one for the parent
+  until it reaches join, whoever takes it to zero continues the parent
+- outside a worker, fork degrades to a plain call; sync_wait from a thread
+  outside the pool doesn't help, so the root and every frame it forks run on
+  workers (other waits that help, like task_group::wait, may still steal a
+  continuation and resume it on their thread)
+- a flat stack relies on the compiler turning the transfers into tail
+  calls, which GCC does from -O2 on and not with -fsanitize=address
+- a forked task must be joined before it is read; if its fork_task is
+  destroyed unjoined, e.g. by an exception thrown between fork and join, the
+  frame is handed to the parent, whose completion waits for the children
+  still running like join does (the implicit sync of Cilk) and frees it
+*/
+template <class T = void>
+class fork_task;
+
+namespace fork_join_detail {
+
+struct promise_base {
+    std::coroutine_handle<> parent;             // continues after this task
+    promise_base* forkParent = nullptr;         // set when forked
+    std::atomic<std::uint32_t>* rootDone = nullptr;     // set by sync_wait
+    std::atomic<std::uint32_t> joins{1};        // of this task's own forks
+    bool finishing = false;                     // completed before its forks
+    std::exception_ptr error;
+    std::coroutine_handle<> self;
+    // forked children whose fork_task was destroyed before join, freed when
+    // this task completes, linked through nextOrphan
+    promise_base* orphans = nullptr;
+    promise_base* nextOrphan = nullptr;
+
+    static void* operator new(std::size_t n) { return block_pool::allocate(n); }
+    static void operator delete(void* p, std::size_t n) noexcept { block_pool::deallocate(p, n); }
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    void unhandled_exception() noexcept { error = std::current_exception(); }
+
+    // after the decrement the parent may finish and destroy this frame, so
+    // everything needed is read before
+    std::coroutine_handle<> complete() noexcept {
+        // every fork is done here, so are the orphans
+        while (orphans) std::exchange(orphans, orphans->nextOrphan)->self.destroy();
+        if (rootDone) {
+            auto* done = rootDone;
+            done->store(2, std::memory_order_release);
+            done->notify_all();
+            // sync_wait may return now and take done with it
+            done->store(1, std::memory_order_release);
+            return std::noop_coroutine();
+        }
+        std::coroutine_handle<> const p = parent;
+        if (!forkParent) return p;
+        promise_base* const fp = forkParent;
+        ThreadPool* pool = ThreadPool::current();
+        bool const resumeHere = pool && pool->pop_continuation(p);
+        // can't be the last while the parent wasn't resumed; a parent that
+        // is finishing waits at its final suspend point, where it can't be
+        // resumed, so the last child completes it instead
+        if (fp->joins.fetch_sub(1, std::memory_order_acq_rel) == 1) return fp->finishing ? fp->complete() : p;
+        return resumeHere ? p : std::noop_coroutine();
+    }
+
+    struct final_awaiter {
+        bool await_ready() const noexcept { return false; }
+        template <class P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept {
+            promise_base& pr = h.promise();
+            // forks left unjoined, only when the body threw or skipped join
+            if (pr.joins.load(std::memory_order_acquire) != 1) {
+                pr.finishing = true;
+                if (pr.joins.fetch_sub(1, std::memory_order_acq_rel) != 1) return std::noop_coroutine();
+            }
+            return pr.complete();
+        }
+        void await_resume() const noexcept {}
+    };
+    final_awaiter final_suspend() noexcept { return {}; }
+};
+
+template <class T>
+struct result_holder : promise_base {
+    std::optional<T> value;
+    template <class U>
+    void return_value(U&& v) { value.emplace(std::forward<U>(v)); }
+};
+
+template <>
+struct result_holder<void> : promise_base {
+    void return_void() noexcept {}
+};
+
+}   // namespace fork_join_detail
+
+template <class T>
+class fork_task {
+public:
+    struct promise_type : fork_join_detail::result_holder<T> {
+        fork_task get_return_object() noexcept {
+            this->self = std::coroutine_handle<promise_type>::from_promise(*this);
+            return fork_task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+    };
+
+private:
+    std::coroutine_handle<promise_type> handle;
+
+    explicit fork_task(std::coroutine_handle<promise_type> h) noexcept : handle(h) {}
+
+    // runs in the parent's frame; a child forked since the parent's last join
+    // may still be running
+    void release() noexcept {
+        auto& p = handle.promise();
+        fork_join_detail::promise_base* const fp = p.forkParent;
+        if (fp && fp->joins.load(std::memory_order_acquire) != 1) {
+            p.nextOrphan = std::exchange(fp->orphans, &p);
+            return;
+        }
+        handle.destroy();
+    }
+
+    template <class U>
+    friend class fork_awaiter;
+    template <class U>
+    friend U sync_wait(ThreadPool&, fork_task<U>);
+
+    struct call_awaiter {
+        std::coroutine_handle<promise_type> child;
+        bool await_ready() const noexcept { return false; }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> h) noexcept {
+            child.promise().parent = h;
+            return child;
+        }
+        T await_resume() { return fork_task::result(child); }
+    };
+
+    static T result(std::coroutine_handle<promise_type> h) {
+        auto& p = h.promise();
+        if (p.error) std::rethrow_exception(p.error);
+        if constexpr (!std::is_void_v<T>) return std::move(*p.value);
+    }
+
+public:
+    fork_task(fork_task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    fork_task& operator=(fork_task&& other) noexcept {
+        if (this != &other) {
+            if (handle) release();
+            handle = std::exchange(other.handle, nullptr);
+        }
+        return *this;
+    }
+    ~fork_task() { if (handle) release(); }
+
+    // run as a plain call, the awaiting coroutine continues when it's done
+    call_awaiter operator co_await() & noexcept { return {handle}; }
+    call_awaiter operator co_await() && noexcept { return {handle}; }
+
+    // result of a forked task after join(), rethrows its exception
+    T get() { return result(handle); }
+};
+
+template <class T>
+class fork_awaiter {
+    fork_task<T>& child;
+public:
+    explicit fork_awaiter(fork_task<T>& c) noexcept : child(c) {}
+    bool await_ready() const noexcept { return false; }
+
+    template <class P>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept {
+        auto const c = child.handle;
+        auto& joins = h.promise().joins;
+        c.promise().parent = h;
+        if (ThreadPool* pool = ThreadPool::current()) {
+            joins.fetch_add(1, std::memory_order_relaxed);
+            c.promise().forkParent = &h.promise();
+            // from here on h may run on a thief, *this is in its frame
+            pool->push_continuation(h);
+        }
+        return c;
+    }
+
+    void await_resume() const noexcept {}
+};
+
+// start c, the awaiting coroutine may continue on another worker meanwhile
+template <class T>
+fork_awaiter<T> fork(fork_task<T>& c) noexcept { return fork_awaiter<T>(c); }
+
+class join_awaiter {
+    std::atomic<std::uint32_t>* joins = nullptr;
+public:
+    bool await_ready() const noexcept { return false; }
+
+    template <class P>
+    bool await_suspend(std::coroutine_handle<P> h) noexcept {
+        joins = &h.promise().joins;
+        // stay suspended unless every child is done, the last one resumes h
+        return joins->fetch_sub(1, std::memory_order_acq_rel) != 1;
+    }
+
+    void await_resume() const noexcept { joins->store(1, std::memory_order_relaxed); }
+};
+
+// wait for every task forked by the awaiting coroutine
+inline join_awaiter join() noexcept { return {}; }
+
+// run t on the pool and block until it is done; a worker runs pool tasks
+// meanwhile, another thread just blocks, so that it resumes no frame
+template <class T>
+T sync_wait(ThreadPool& pool, fork_task<T> t) {
+    // 0 while running, 2 while the root notifies, 1 once it returned from
+    // notify_all(): done lives on this stack, so only 1 lets it go
+    std::atomic<std::uint32_t> done{0};
+    auto const h = t.handle;
+    h.promise().rootDone = &done;
+    pool.post([h] { h.resume(); });
+    for (;;) {
+        std::uint32_t const d = done.load(std::memory_order_acquire);
+        if (d == 1) break;
+        if (d == 2) std::this_thread::yield();
+        else if (ThreadPool::current() != &pool || !pool.tryRunPendingTask())
+            done.wait(0, std::memory_order_acquire);
+    }
+    return t.get();
+}
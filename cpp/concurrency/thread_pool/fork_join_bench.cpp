@@ -0,0 +1,105 @@
+/*
+divide and conquer overhead: fib(n) and quicksort, serial vs
+- fork_join.hpp: fork / join with continuation stealing
+- task_group: run() the child, recurse on the other half, wait() helps
+- submit + runPendingTask: the parent spins on the child's future
+
+build: g++ -std=c++20 -O2 -pthread fork_join_bench.cpp
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "fork_join.hpp"
+#include "task_group.hpp"
+
+constexpr int fibN = 30;
+constexpr int cutoff = 12;     // below it the recursion is serial everywhere
+constexpr std::size_t sortSize = 1 << 22;
+constexpr std::ptrdiff_t sortCutoff = 2048;
+
+long fibSerial(int n) { return n < 2 ? n : fibSerial(n - 1) + fibSerial(n - 2); }
+
+fork_task<long> fibFork(int n) {
+    if (n < cutoff) co_return fibSerial(n);
+    auto a = fibFork(n - 1);
+    co_await fork(a);
+    long const b = co_await fibFork(n - 2);
+    co_await join();
+    co_return a.get() + b;
+}
+
+long fibGroup(ThreadPool& pool, int n) {
+    if (n < cutoff) return fibSerial(n);
+    long a = 0;
+    task_group g(pool);
+    g.run([&] { a = fibGroup(pool, n - 1); });
+    long const b = fibGroup(pool, n - 2);
+    g.wait();
+    return a + b;
+}
+
+long fibSubmit(ThreadPool& pool, int n) {
+    if (n < cutoff) return fibSerial(n);
+    auto a = pool.submit([&pool, n] { return fibSubmit(pool, n - 1); });
+    long const b = fibSubmit(pool, n - 2);
+    while (!a.is_ready()) pool.runPendingTask();
+    return a.get() + b;
+}
+
+std::pair<int*, int*> partition3(int* b, int* e) {
+    int const pivot = b[(e - b) / 2];
+    int* m1 = std::partition(b, e, [&](int x) { return x < pivot; });
+    int* m2 = std::partition(m1, e, [&](int x) { return x == pivot; });
+    return {m1, m2};
+}
+
+fork_task<> sortFork(int* b, int* e) {
+    if (e - b < sortCutoff) {
+        std::sort(b, e);
+        co_return;
+    }
+    auto [m1, m2] = partition3(b, e);
+    auto left = sortFork(b, m1);
+    co_await fork(left);
+    co_await sortFork(m2, e);
+    co_await join();
+}
+
+void sortGroup(ThreadPool& pool, int* b, int* e) {
+    if (e - b < sortCutoff) return std::sort(b, e);
+    auto [m1, m2] = partition3(b, e);
+    task_group g(pool);
+    g.run([&pool, b, m1 = m1] { sortGroup(pool, b, m1); });
+    sortGroup(pool, m2, e);
+    g.wait();
+}
+
+template <class F>
+void report(char const* name, F&& body) {
+    auto const start = std::chrono::steady_clock::now();
+    body();
+    std::chrono::duration<double> const elapsed = std::chrono::steady_clock::now() - start;
+    std::printf("%-32s %9.2f ms\n", name, elapsed.count() * 1e3);
+}
+
+int main() {
+    ThreadPool pool;
+    long sink = 0;
+    report("fib serial", [&] { sink += fibSerial(fibN); });
+    report("fib fork/join", [&] { sink += sync_wait(pool, fibFork(fibN)); });
+    report("fib task_group", [&] { sink += fibGroup(pool, fibN); });
+    report("fib submit + runPendingTask", [&] { sink += fibSubmit(pool, fibN); });
+
+    std::vector<int> input(sortSize);
+    std::mt19937 gen(42);
+    for (auto& x : input) x = static_cast<int>(gen());
+    auto v = input;
+    report("sort serial", [&] { std::sort(v.begin(), v.end()); });
+    v = input;
+    report("sort fork/join", [&] { sync_wait(pool, sortFork(v.data(), v.data() + v.size())); });
+    v = input;
+    report("sort task_group", [&] { sortGroup(pool, v.data(), v.data() + v.size()); });
+    return sink == 42;
+}
@@ -0,0 +1,80 @@
+/*
+an exception thrown between fork and join must not destroy a forked child
+that is still running
+- the parent forks a child that runs for a while, then throws before join;
+  sync_wait rethrows only after the child finished, and every frame is freed
+- the same throw deep inside a fork/join recursion, from many workers at once
+
+build: g++ -std=c++20 -O2 -pthread fork_join_test.cpp
+*/
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <thread>
+#include "fork_join.hpp"
+
+std::atomic<int> alive{0};
+std::atomic<int> childrenDone{0};
+
+struct counted {
+    counted() { alive.fetch_add(1); }
+    ~counted() { alive.fetch_sub(1); }
+};
+
+fork_task<int> slowChild() {
+    counted c;
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    childrenDone.fetch_add(1);
+    co_return 1;
+}
+
+fork_task<int> throwAfterFork() {
+    counted c;
+    auto a = slowChild();
+    co_await fork(a);
+    throw std::runtime_error("between fork and join");
+    co_await join();
+    co_return a.get();
+}
+
+fork_task<long> fib(int n) {
+    counted c;
+    if (n < 2) co_return n;
+    auto a = fib(n - 1);
+    co_await fork(a);
+    if (n == 12) throw std::runtime_error("deep");
+    long const b = co_await fib(n - 2);
+    co_await join();
+    co_return a.get() + b;
+}
+
+int main() {
+    ThreadPool pool(4);
+    for (int i = 0; i < 20; ++i) {
+        bool thrown = false;
+        try {
+            sync_wait(pool, throwAfterFork());
+        }
+        catch (std::runtime_error const&) {
+            thrown = true;
+        }
+        assert(thrown);
+        assert(childrenDone.load() == i + 1);
+        assert(alive.load() == 0);
+    }
+    for (int i = 0; i < 20; ++i) {
+        bool thrown = false;
+        try {
+            sync_wait(pool, fib(20));
+        }
+        catch (std::runtime_error const&) {
+            thrown = true;
+        }
+        assert(thrown);
+        assert(alive.load() == 0);
+    }
+    assert(sync_wait(pool, fib(11)) == 89);
+    std::puts("ok");
+}
@@ -0,0 +1,83 @@
+/*
+tasks/sec submitted from threads outside the pool, 1 to 64 producers
+- "queue": producers push task_nodes, 4 consumers pop them, the mutex
+  protected task_queue that used to be the global queue vs the sharded
+  injection_queue
+- "pool": producers post to a ThreadPool, the workers run the tasks
+
+build: g++ -std=c++20 -O2 -pthread inject_bench.cpp
+*/
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include "thread_pool.hpp"
+
+constexpr std::size_t numTasks = 1 << 20;
+
+template <class F>
+void report(char const* name, unsigned producers, F&& body) {
+    auto const start = std::chrono::steady_clock::now();
+    body();
+    std::chrono::duration<double> const elapsed = std::chrono::steady_clock::now() - start;
+    std::printf("%-28s %2u producers %12.0f tasks/s\n", name, producers, numTasks / elapsed.count());
+}
+
+// pop/push adapters so both queues run the same loop
+struct MutexQueue {
+    task_queue q;
+    void push(task_node* n, std::size_t) { q.push(n); }
+    task_node* try_pop(std::size_t) { return q.try_pop(); }
+};
+
+struct ShardedQueue {
+    injection_queue q{16};
+    void push(task_node* n, std::size_t key) { q.push(n, key); }
+    task_node* try_pop(std::size_t home) { return q.try_pop(home); }
+};
+
+template <class Queue>
+void queueOnly(unsigned producers) {
+    constexpr unsigned consumers = 4;
+    Queue queue;
+    std::vector<task_node> nodes(numTasks);
+    std::atomic<std::size_t> popped{0};
+    std::vector<std::jthread> threads;
+    for (unsigned c = 0; c < consumers; ++c) {
+        threads.emplace_back([&, c] {
+            while (popped.load(std::memory_order_relaxed) < numTasks) {
+                if (queue.try_pop(c)) popped.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+    for (unsigned p = 0; p < producers; ++p) {
+        threads.emplace_back([&, p] {
+            std::size_t const key = std::hash<std::thread::id>{}(std::this_thread::get_id());
+            for (std::size_t i = p; i < numTasks; i += producers) queue.push(&nodes[i], key);
+        });
+    }
+}
+
+void pool(unsigned producers) {
+    ThreadPool pool;
+    std::atomic<std::size_t> done{0};
+    {
+        std::vector<std::jthread> threads;
+        for (unsigned p = 0; p < producers; ++p) {
+            threads.emplace_back([&, p] {
+                for (std::size_t i = p; i < numTasks; i += producers)
+                    pool.post(make_task_node([&] { done.fetch_add(1, std::memory_order_relaxed); }));
+            });
+        }
+    }
+    while (done.load(std::memory_order_relaxed) < numTasks) std::this_thread::yield();
+}
+
+int main() {
+    for (unsigned producers : {1u, 2u, 4u, 8u, 16u, 32u, 64u}) {
+        report("queue: mutex task_queue", producers, [&] { queueOnly<MutexQueue>(producers); });
+        report("queue: injection_queue", producers, [&] { queueOnly<ShardedQueue>(producers); });
+        report("pool: post from outside", producers, [&] { pool(producers); });
+    }
+}
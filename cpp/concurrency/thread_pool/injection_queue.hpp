@@ -0,0 +1,145 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include "task_node.hpp"
+
+/*
+Sharded injection queue for tasks submitted from outside a ThreadPool
+- a single mutex-protected FIFO is the contention hotspot once many threads
+  submit at once: every push and every worker poll takes the same lock
+- instead each shard is a bounded lock-free MPMC ring of task_node pointers
+  (Vyukov: every cell carries a sequence number telling producers and
+  consumers whose turn it is, so a push or pop is one CAS on the shard's
+  enqueue or dequeue position), submitters spread over the shards by thread
+  and workers start polling at their home shard
+- a full ring spills into the shard's mutex-protected overflow list, pushes
+  keep going there until it drained, so a producer's tasks stay in order as
+  long as it only uses its own shard
+- polling an empty shard only reads, idle workers scanning all shards share
+  those cache lines instead of bouncing them
+- not strictly lock-free: a producer preempted between its CAS and its
+  sequence store keeps consumers from passing that cell until it resumes
+*/
+class injection_queue {
+    class shard {
+        struct cell {
+            std::atomic<std::size_t> seq;
+            task_node* node;
+        };
+        static constexpr std::size_t capacity = 1024;    // power of 2
+
+        alignas(std::hardware_destructive_interference_size) std::atomic<std::size_t> enqueuePos{0};
+        alignas(std::hardware_destructive_interference_size) std::atomic<std::size_t> dequeuePos{0};
+        std::unique_ptr<cell[]> cells{new cell[capacity]};
+        task_queue overflow;
+
+        bool try_push_ring(task_node* node) noexcept {
+            std::size_t pos = enqueuePos.load(std::memory_order_relaxed);
+            for (;;) {
+                cell& c = cells[pos & (capacity - 1)];
+                std::size_t const seq = c.seq.load(std::memory_order_acquire);
+                auto const diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+                if (diff == 0) {
+                    if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        c.node = node;
+                        c.seq.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (diff < 0) {
+                    return false;   // full
+                }
+                else {
+                    pos = enqueuePos.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        task_node* try_pop_ring() noexcept {
+            std::size_t pos = dequeuePos.load(std::memory_order_relaxed);
+            for (;;) {
+                cell& c = cells[pos & (capacity - 1)];
+                std::size_t const seq = c.seq.load(std::memory_order_acquire);
+                auto const diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1);
+                if (diff == 0) {
+                    if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        task_node* node = c.node;
+                        c.seq.store(pos + capacity, std::memory_order_release);
+                        return node;
+                    }
+                }
+                else if (diff < 0) {
+                    return nullptr;     // empty
+                }
+                else {
+                    pos = dequeuePos.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+    public:
+        shard() {
+            for (std::size_t i = 0; i < capacity; ++i) cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+
+        void push(task_node* node) {
+            if (overflow.size() == 0 && try_push_ring(node)) return;
+            overflow.push(node);
+        }
+
+        task_node* try_pop() {
+            if (task_node* node = try_pop_ring()) return node;
+            return overflow.size() != 0 ? overflow.try_pop() : nullptr;
+        }
+
+        // approximate
+        std::size_t size() const noexcept {
+            std::size_t const e = enqueuePos.load(std::memory_order_relaxed);
+            std::size_t const d = dequeuePos.load(std::memory_order_relaxed);
+            return (e > d ? e - d : 0) + overflow.size();
+        }
+    };
+
+    std::unique_ptr<shard[]> shards;
+    std::size_t mask;
+
+public:
+    explicit injection_queue(std::size_t numShards)
+        : shards(new shard[std::bit_ceil(std::max<std::size_t>(numShards, 1))]),
+          mask(std::bit_ceil(std::max<std::size_t>(numShards, 1)) - 1) {}
+    injection_queue(injection_queue const&) = delete;
+    injection_queue& operator=(injection_queue const&) = delete;
+
+    std::size_t num_shards() const noexcept { return mask + 1; }
+
+    // `key` picks the shard, e.g. a hash of the submitting thread; it is
+    // mixed here, std::hash of a thread id is often just an aligned pointer
+    void push(task_node* node, std::size_t key) {
+        shards[home_of(key)].push(node);
+    }
+
+    // starts at shard `home` (a worker index, or home_of(key) for a
+    // submitter) and goes on round robin
+    task_node* try_pop(std::size_t home) {
+        for (std::size_t i = 0; i <= mask; ++i) {
+            if (task_node* node = shards[(home + i) & mask].try_pop()) return node;
+        }
+        return nullptr;
+    }
+
+    // home shard for key, as used by push
+    std::size_t home_of(std::size_t key) const noexcept {
+        return (key * 0x9E3779B97F4A7C15ull >> 32) & mask;
+    }
+
+    std::size_t size() const noexcept {
+        std::size_t res = 0;
+        for (std::size_t i = 0; i <= mask; ++i) res += shards[i].size();
+        return res;
+    }
+};
@@ -0,0 +1,248 @@
+#pragma once
+#include <atomic>
+#include <concepts>
+#include <cstdint>
+#include <thread>
+#include <utility>
+
+/*
+Stop source / token / callback without allocation, after P2300's
+std::inplace_stop_source
+- std::stop_source allocates a reference-counted control block and takes an
+  internal lock for every std::stop_callback; here the state is a single word
+  inside the source itself, so the source can live in a task's pooled block,
+  and the source must outlive its tokens and callbacks
+- state: head of the intrusive list of registered callbacks | stop bit | lock
+  bit; registering a callback is one CAS pushing it onto the list, also while
+  the lock bit is held, so registration is lock-free; the lock bit is only
+  taken to unlink a callback and by request_stop while it pops the callbacks
+  one by one; the lock holder owns the links, but until stop is requested
+  new callbacks may still land on top of the list, so it changes the head
+  with a CAS and unlocks with fetch_and
+- callbacks run on the thread calling request_stop, outside the lock; a
+  callback destroyed concurrently with its execution waits until it finished,
+  unless it is destroyed from inside its own callback
+
+Cancellation scopes
+- a source constructed from a parent token is a child scope: its tokens
+  report a stop requested on any ancestor, so a single store on the root of a
+  scope tree cancels every task below it, no matter how many there are
+- tasks that only poll stop_requested() cost nothing to the parent; the first
+  callback registered on a child registers a forwarding callback on the
+  parent, so callbacks below a stopped scope run as well
+- a parent must outlive its children
+*/
+class inplace_stop_source;
+
+class inplace_stop_callback_base {
+    friend class inplace_stop_source;
+    inplace_stop_callback_base* next = nullptr;
+    bool* removedDuringCallback = nullptr;
+    std::atomic<bool> done{false};
+protected:
+    void (*execute)(inplace_stop_callback_base*) noexcept;
+    explicit inplace_stop_callback_base(void (*e)(inplace_stop_callback_base*) noexcept) noexcept
+        : execute(e) {}
+};
+
+class inplace_stop_token {
+    friend class inplace_stop_source;
+    template <class CB>
+    friend class inplace_stop_callback;
+
+    inplace_stop_source* source = nullptr;
+    explicit inplace_stop_token(inplace_stop_source* s) noexcept : source(s) {}
+public:
+    inplace_stop_token() noexcept = default;
+
+    bool stop_requested() const noexcept;
+    bool stop_possible() const noexcept { return source != nullptr; }
+    friend bool operator==(inplace_stop_token, inplace_stop_token) = default;
+};
+
+class inplace_stop_source {
+    static constexpr std::uintptr_t stopBit = 1;
+    static constexpr std::uintptr_t lockBit = 2;
+    static constexpr std::uintptr_t bits = stopBit | lockBit;
+
+    std::atomic<std::uintptr_t> state{0};
+    inplace_stop_source* parent = nullptr;
+    std::thread::id requester;      // written under the lock by request_stop
+
+    // registered on the parent by the first callback registered here
+    struct forwarder : inplace_stop_callback_base {
+        inplace_stop_source* self;
+        std::atomic<bool> started{false};
+        bool registered = false;
+        explicit forwarder(inplace_stop_source* s) noexcept
+            : inplace_stop_callback_base([](inplace_stop_callback_base* b) noexcept {
+                  static_cast<forwarder*>(b)->self->request_stop();
+              }), self(s) {}
+    } forward{this};
+
+    template <class CB>
+    friend class inplace_stop_callback;
+
+    static inplace_stop_callback_base* head(std::uintptr_t s) noexcept {
+        return reinterpret_cast<inplace_stop_callback_base*>(s & ~bits);
+    }
+    static std::uintptr_t word(inplace_stop_callback_base* cb) noexcept {
+        return reinterpret_cast<std::uintptr_t>(cb);
+    }
+
+    // returns the state with the lock bit set by us, holders never block, so
+    // yielding is enough
+    std::uintptr_t lock() noexcept {
+        std::uintptr_t s = state.load(std::memory_order_relaxed);
+        for (;;) {
+            if (s & lockBit) {
+                std::this_thread::yield();
+                s = state.load(std::memory_order_relaxed);
+            }
+            else if (state.compare_exchange_weak(s, s | lockBit, std::memory_order_acquire,
+                                                 std::memory_order_relaxed)) {
+                return s | lockBit;
+            }
+        }
+    }
+
+    void forward_to_parent() noexcept {
+        if (!parent || forward.started.load(std::memory_order_relaxed)) return;
+        if (forward.started.exchange(true, std::memory_order_relaxed)) return;
+        forward.registered = parent->try_add(&forward);
+    }
+
+    // false if stop was already requested, cb has run on this thread then
+    bool try_add(inplace_stop_callback_base* cb) noexcept {
+        forward_to_parent();
+        std::uintptr_t s = state.load(std::memory_order_acquire);
+        for (;;) {
+            if (s & stopBit) {
+                cb->execute(cb);
+                return false;
+            }
+            // keeps the lock bit of whoever is unlinking
+            cb->next = head(s);
+            if (state.compare_exchange_weak(s, word(cb) | (s & lockBit), std::memory_order_release,
+                                            std::memory_order_acquire))
+                return true;
+        }
+    }
+
+    void remove(inplace_stop_callback_base* cb) noexcept {
+        std::uintptr_t s = lock();
+        // registrations may push onto the head meanwhile, then cb is further
+        // down; the links below the head are only changed under the lock
+        while (head(s) == cb) {
+            if (state.compare_exchange_weak(s, word(cb->next) | (s & stopBit), std::memory_order_release,
+                                            std::memory_order_acquire))
+                return;
+        }
+        for (auto* p = head(s); p; p = p->next) {
+            if (p->next == cb) {
+                p->next = cb->next;
+                state.fetch_and(~lockBit, std::memory_order_release);
+                return;
+            }
+        }
+        // not in the list: request_stop popped it, it is running or done
+        bool const sameThread = requester == std::this_thread::get_id();
+        state.fetch_and(~lockBit, std::memory_order_release);
+        if (sameThread) {
+            // from inside a callback: either cb's own, which must not touch
+            // cb after it returns, or another one, then cb is done already
+            if (cb->removedDuringCallback) *cb->removedDuringCallback = true;
+        }
+        else {
+            while (!cb->done.load(std::memory_order_acquire))
+                cb->done.wait(false, std::memory_order_acquire);
+        }
+    }
+
+public:
+    inplace_stop_source() noexcept = default;
+    // child scope of `parent`, see above
+    explicit inplace_stop_source(inplace_stop_token parent) noexcept : parent(parent.source) {}
+    inplace_stop_source(inplace_stop_source const&) = delete;
+    inplace_stop_source& operator=(inplace_stop_source const&) = delete;
+    ~inplace_stop_source() {
+        if (forward.registered) parent->remove(&forward);
+    }
+
+    inplace_stop_token get_token() noexcept { return inplace_stop_token(this); }
+
+    bool stop_requested() const noexcept {
+        for (auto* s = this; s; s = s->parent) {
+            if (s->state.load(std::memory_order_acquire) & stopBit) return true;
+        }
+        return false;
+    }
+
+    // true for the call that requested stop, which also runs the callbacks
+    bool request_stop() noexcept {
+        std::uintptr_t s = state.load(std::memory_order_relaxed);
+        for (;;) {
+            if (s & stopBit) return false;
+            if (s & lockBit) {
+                std::this_thread::yield();
+                s = state.load(std::memory_order_relaxed);
+            }
+            else if (state.compare_exchange_weak(s, s | stopBit | lockBit, std::memory_order_acq_rel,
+                                                 std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        requester = std::this_thread::get_id();
+        // with the stop bit set no callback is pushed anymore, plain stores
+        // are enough from here on
+        for (s |= stopBit | lockBit;; s = lock()) {
+            inplace_stop_callback_base* cb = head(s);
+            if (!cb) {
+                state.store(stopBit, std::memory_order_release);
+                return true;
+            }
+            bool removed = false;
+            cb->removedDuringCallback = &removed;
+            // pop and unlock, so that other callbacks can be removed while
+            // this one runs
+            state.store(word(cb->next) | stopBit, std::memory_order_release);
+            cb->execute(cb);
+            if (!removed) {
+                cb->removedDuringCallback = nullptr;
+                cb->done.store(true, std::memory_order_release);
+                cb->done.notify_all();
+            }
+        }
+    }
+};
+
+inline bool inplace_stop_token::stop_requested() const noexcept {
+    return source && source->stop_requested();
+}
+
+// runs cb on request_stop, or in the constructor if stop was already requested
+template <class CB>
+class inplace_stop_callback : private inplace_stop_callback_base {
+    inplace_stop_source* source;
+    CB cb;
+    bool registered = false;
+
+    static void run(inplace_stop_callback_base* b) noexcept {
+        static_cast<inplace_stop_callback*>(b)->cb();
+    }
+public:
+    template <class C>
+        requires std::constructible_from<CB, C>
+    explicit inplace_stop_callback(inplace_stop_token st, C&& c)
+        : inplace_stop_callback_base(&run), source(st.source), cb(std::forward<C>(c)) {
+        if (source) registered = source->try_add(this);
+    }
+    inplace_stop_callback(inplace_stop_callback const&) = delete;
+    inplace_stop_callback& operator=(inplace_stop_callback const&) = delete;
+    ~inplace_stop_callback() {
+        if (registered) source->remove(this);
+    }
+};
+
+template <class CB>
+inplace_stop_callback(inplace_stop_token, CB) -> inplace_stop_callback<CB>;
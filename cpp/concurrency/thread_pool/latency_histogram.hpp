@@ -0,0 +1,61 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+
+/*
+Log2-bucketed histogram of durations in nanoseconds
+- bucket i counts values in [2^i, 2^(i+1)), so percentiles are accurate to
+  a factor of 2, which is enough to tell 1us from 1ms
+- one writer (the owning worker) and any number of readers: the writer uses
+  load + store instead of an RMW, readers may see a slightly stale snapshot
+*/
+class latency_histogram {
+public:
+    static constexpr std::size_t num_buckets = 48;
+
+    class snapshot {
+        std::array<std::uint64_t, num_buckets> counts{};
+        friend class latency_histogram;
+    public:
+        snapshot& operator+=(snapshot const& other) noexcept {
+            for (std::size_t i = 0; i < num_buckets; ++i) counts[i] += other.counts[i];
+            return *this;
+        }
+
+        std::uint64_t count() const noexcept {
+            std::uint64_t res = 0;
+            for (auto c : counts) res += c;
+            return res;
+        }
+
+        // upper bound of the bucket holding the p-th quantile, p in [0, 1]
+        std::chrono::nanoseconds percentile(double p) const noexcept {
+            std::uint64_t const total = count();
+            if (total == 0) return std::chrono::nanoseconds(0);
+            auto const rank = static_cast<std::uint64_t>(p * static_cast<double>(total - 1));
+            std::uint64_t seen = 0;
+            for (std::size_t i = 0; i < num_buckets; ++i) {
+                seen += counts[i];
+                if (seen > rank) return std::chrono::nanoseconds(std::int64_t{2} << i);
+            }
+            return std::chrono::nanoseconds(std::int64_t{2} << (num_buckets - 1));
+        }
+    };
+
+    void record(std::int64_t ns) noexcept {
+        std::size_t i = ns <= 1 ? 0 : std::bit_width(static_cast<std::uint64_t>(ns)) - 1;
+        if (i >= num_buckets) i = num_buckets - 1;
+        buckets[i].store(buckets[i].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    void add_to(snapshot& s) const noexcept {
+        for (std::size_t i = 0; i < num_buckets; ++i)
+            s.counts[i] += buckets[i].load(std::memory_order_relaxed);
+    }
+
+private:
+    std::array<std::atomic<std::uint64_t>, num_buckets> buckets{};
+};
@@ -0,0 +1,203 @@
+#pragma once
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <ranges>
+#include <utility>
+#include <vector>
+#include "thread_pool.hpp"
+
+/*
+Parallel algorithms on a ThreadPool
+- every algorithm cuts the range into blocks of `grain` elements and runs the
+  blocks through ThreadPool::parallel_for, whose lazy splitting leaves load
+  balancing to work stealing: a worker that finishes early steals the
+  biggest untouched half of someone else's blocks
+- grain 0 picks about 8 blocks per worker, but (except for for_each) at
+  least a few thousand elements so that a block amortizes the scheduling cost
+- op must be associative, it doesn't have to be commutative: partial results
+  are combined in block order
+- the calling thread runs pool tasks while it waits, so the algorithms can be
+  called from inside a task as well
+- the range must not be modified while the algorithm runs, the first
+  exception thrown by an element function is rethrown, the range is then
+  left in a valid but unspecified state
+*/
+
+namespace parallel_detail {
+
+inline std::size_t pick_grain(ThreadPool& pool, std::size_t n, std::size_t grain) {
+    if (grain != 0) return grain;
+    return std::max<std::size_t>(n / (8 * std::max(pool.numWorkers(), 1u)), 4096);
+}
+
+inline void help_until_ready(ThreadPool& pool, bulk_handle h) {
+    while (!h.is_ready()) pool.runPendingTask();
+    h.get();
+}
+
+// run f(lo, hi) for consecutive blocks of at most grain elements of [0, n)
+template <class F>
+void for_blocks(ThreadPool& pool, std::size_t n, std::size_t grain, F&& f) {
+    std::size_t const blocks = (n + grain - 1) / grain;
+    help_until_ready(pool, pool.parallel_for(std::size_t{0}, blocks, 1, [&](std::size_t b) {
+        f(b * grain, std::min(n, (b + 1) * grain));
+    }));
+}
+
+// merge path: how many of the first k outputs of merge(a[0, m), b[0, l))
+// come from a, ties go to a like in std::merge
+template <class It1, class It2, class Comp>
+std::size_t co_rank(std::size_t k, It1 a, std::size_t m, It2 b, std::size_t l, Comp& comp) {
+    std::size_t lo = k > l ? k - l : 0;
+    std::size_t hi = std::min(k, m);
+    while (lo < hi) {
+        std::size_t const mid = lo + (hi - lo) / 2;
+        // a[mid] is output before b[k - mid - 1]: take more from a
+        if (!comp(b[k - mid - 1], a[mid])) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// one merge round: sorted runs of `width` in src are merged pairwise into
+// dst, the round is split into blocks of the output (grain divides 2 *
+// width), so even the last round, a single merge, runs in parallel
+template <class Src, class Dst, class Comp>
+void merge_round(ThreadPool& pool, Src src, Dst dst, std::size_t n, std::size_t width,
+                 std::size_t grain, Comp& comp) {
+    for_blocks(pool, n, grain, [&](std::size_t lo, std::size_t hi) {
+        std::size_t const base = lo / (2 * width) * (2 * width);
+        std::size_t const mid = std::min(n, base + width);
+        std::size_t const end = std::min(n, base + 2 * width);
+        auto const a = src + base;
+        auto const b = src + mid;
+        std::size_t const m = mid - base, l = end - mid;
+        std::size_t const i0 = co_rank(lo - base, a, m, b, l, comp);
+        std::size_t const i1 = co_rank(hi - base, a, m, b, l, comp);
+        std::size_t const j0 = lo - base - i0, j1 = hi - base - i1;
+        std::merge(std::make_move_iterator(a + i0), std::make_move_iterator(a + i1),
+                   std::make_move_iterator(b + j0), std::make_move_iterator(b + j1),
+                   dst + lo, comp);
+    });
+}
+
+} // namespace parallel_detail
+
+// f(x) for every element, in no particular order
+template <std::ranges::random_access_range R, class F>
+    requires std::ranges::sized_range<R> &&
+             std::invocable<F const&, std::ranges::range_reference_t<R>>
+void parallel_for_each(ThreadPool& pool, R&& range, F f, std::size_t grain = 0) {
+    // no minimum grain here, f may be expensive
+    parallel_detail::help_until_ready(pool, pool.submit_bulk(range, std::move(f), grain));
+}
+
+// init op t(x0) op t(x1) op ..., grouped by blocks
+template <std::ranges::random_access_range R, class T, class Op, class Transform>
+    requires std::ranges::sized_range<R> &&
+             std::invocable<Transform const&, std::ranges::range_reference_t<R>> &&
+             std::invocable<Op const&, T, T>
+T parallel_transform_reduce(ThreadPool& pool, R&& range, T init, Op op, Transform t,
+                            std::size_t grain = 0) {
+    auto const n = static_cast<std::size_t>(std::ranges::size(range));
+    if (n == 0) return init;
+    grain = parallel_detail::pick_grain(pool, n, grain);
+    auto const first = std::ranges::begin(range);
+    // optional: T need not be default constructible
+    std::vector<std::optional<T>> partial((n + grain - 1) / grain);
+    parallel_detail::for_blocks(pool, n, grain, [&](std::size_t lo, std::size_t hi) {
+        T acc = t(first[lo]);
+        for (std::size_t i = lo + 1; i != hi; ++i) acc = op(std::move(acc), t(first[i]));
+        partial[lo / grain].emplace(std::move(acc));
+    });
+    for (auto& p : partial) init = op(std::move(init), std::move(*p));
+    return init;
+}
+
+template <std::ranges::random_access_range R, class T, class Op = std::plus<>>
+    requires std::ranges::sized_range<R> && std::invocable<Op const&, T, T>
+T parallel_reduce(ThreadPool& pool, R&& range, T init, Op op = {}, std::size_t grain = 0) {
+    return parallel_transform_reduce(pool, range, std::move(init), std::move(op),
+                                     std::identity{}, grain);
+}
+
+/*
+out[i] = x0 op x1 op ... op xi, returns out + size
+- two passes over blocks: reduce every block (the last one is not needed),
+  scan the block sums serially, then scan every block again starting from
+  the sum of the blocks before it
+- about 2n applications of op instead of n, so it only pays off with 3 or
+  more workers; in and out may be the same range
+*/
+template <std::ranges::random_access_range R, std::random_access_iterator O, class Op = std::plus<>>
+    requires std::ranges::sized_range<R> &&
+             std::indirectly_writable<O, std::ranges::range_value_t<R>>
+O parallel_inclusive_scan(ThreadPool& pool, R&& range, O out, Op op = {}, std::size_t grain = 0) {
+    using T = std::ranges::range_value_t<R>;
+    auto const n = static_cast<std::size_t>(std::ranges::size(range));
+    if (n == 0) return out;
+    grain = parallel_detail::pick_grain(pool, n, grain);
+    auto const first = std::ranges::begin(range);
+    std::size_t const blocks = (n + grain - 1) / grain;
+    std::vector<std::optional<T>> carry(blocks);
+    if (blocks > 1) {
+        parallel_detail::for_blocks(pool, (blocks - 1) * grain, grain, [&](std::size_t lo, std::size_t hi) {
+            T acc = first[lo];
+            for (std::size_t i = lo + 1; i != hi; ++i) acc = op(std::move(acc), first[i]);
+            carry[lo / grain + 1].emplace(std::move(acc));
+        });
+        // carry[b]: everything before block b
+        for (std::size_t b = 2; b < blocks; ++b) carry[b] = op(*carry[b - 1], std::move(*carry[b]));
+    }
+    parallel_detail::for_blocks(pool, n, grain, [&](std::size_t lo, std::size_t hi) {
+        auto const& c = carry[lo / grain];
+        T acc = c ? op(*c, first[lo]) : T(first[lo]);
+        out[lo] = acc;
+        for (std::size_t i = lo + 1; i != hi; ++i) {
+            acc = op(std::move(acc), first[i]);
+            out[i] = acc;
+        }
+    });
+    return out + n;
+}
+
+/*
+merge sort, not stable (blocks are sorted with std::sort)
+- sort blocks of `grain` elements in parallel, then merge runs pairwise
+  between the range and a buffer, log2(n / grain) rounds
+- every round is split by output position using merge path (binary search
+  for where a block of the output starts in both input runs), so the final
+  rounds that merge a few huge runs still use every worker
+- needs a buffer of n elements, the value type must be default constructible
+*/
+template <std::ranges::random_access_range R, class Comp = std::ranges::less>
+    requires std::ranges::sized_range<R> && std::sortable<std::ranges::iterator_t<R>, Comp> &&
+             std::default_initializable<std::ranges::range_value_t<R>>
+void parallel_sort(ThreadPool& pool, R&& range, Comp comp = {}, std::size_t grain = 0) {
+    auto const n = static_cast<std::size_t>(std::ranges::size(range));
+    grain = parallel_detail::pick_grain(pool, n, grain);
+    auto const first = std::ranges::begin(range);
+    if (n <= grain) {
+        std::sort(first, first + n, comp);
+        return;
+    }
+    parallel_detail::for_blocks(pool, n, grain, [&](std::size_t lo, std::size_t hi) {
+        std::sort(first + lo, first + hi, comp);
+    });
+    std::vector<std::ranges::range_value_t<R>> buffer(n);
+    bool inBuffer = false;
+    for (std::size_t width = grain; width < n; width *= 2) {
+        if (inBuffer) parallel_detail::merge_round(pool, buffer.begin(), first, n, width, grain, comp);
+        else parallel_detail::merge_round(pool, first, buffer.begin(), n, width, grain, comp);
+        inBuffer = !inBuffer;
+    }
+    if (inBuffer) {
+        parallel_detail::for_blocks(pool, n, grain, [&](std::size_t lo, std::size_t hi) {
+            std::move(buffer.begin() + lo, buffer.begin() + hi, first + lo);
+        });
+    }
+}
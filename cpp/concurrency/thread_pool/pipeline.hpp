@@ -0,0 +1,506 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+#include "thread_pool.hpp"
+
+/*
+Streaming pipeline on a ThreadPool: stages linked by bounded rings
+    pipeline<std::string> p(pool);
+    p.then(stage_mode::parallel, parse)         // std::string -> Record
+     .then(stage_mode::parallel, transform)     // -> std::optional<Record>, nullopt drops the item
+     .then(stage_mode::serial, emit);           // void: the sink
+    for (auto& line : input) p.push(std::move(line));
+    p.close();
+    p.wait();
+- every stage has a bounded lock-free MPMC ring as input (Vyukov cells with
+  sequence numbers); a batch of free or filled cells is claimed with one CAS,
+  so items move `batch` at a time
+- a stage runs as pool tasks, at most one for a serial stage (items are
+  processed in the order they were queued) and up to `maxParallelism` for a
+  parallel one; pushing into a ring schedules its stage if it is below that
+  limit, a stage task whose ring is empty ends, nothing waits on a queue
+- backpressure: when the next ring is full, the task keeps the outputs that
+  didn't fit, marks the stage blocked and ends; blocked stages take nothing
+  from their input, which then fills up in turn, and the next stage
+  reschedules it once it took items out; push() from outside waits (and
+  helps the pool) while the first ring is full, so memory stays bounded by
+  the ring capacities
+- if a stage throws, the rest of the items are dropped and wait() rethrows
+- build all stages before the first push; the destructor closes and waits
+*/
+enum class stage_mode { serial, parallel };
+
+struct pipeline_options {
+    std::size_t capacity = 1024;        // per stage input ring, rounded up to a power of 2
+    std::size_t batch = 32;             // items a stage task moves per step
+    unsigned int maxParallelism = 0;    // tasks per parallel stage, 0: pool.numWorkers()
+};
+
+struct pipeline_stage_stats {
+    stage_mode mode;
+    std::uint64_t items;        // taken from the input ring
+    std::uint64_t batches;
+    std::uint64_t stalls;       // times the next ring was full
+    std::size_t queued;         // in the input ring, approximate
+    std::size_t capacity;
+    double throughput;          // items/s since the pipeline was created
+};
+
+namespace pipeline_detail {
+
+// bounded MPMC ring of T, like injection_queue's shards but the cells hold
+// the items and a range of cells is claimed at once
+template <class T>
+class ring {
+    struct cell {
+        std::atomic<std::size_t> seq;
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T* item() noexcept { return std::launder(reinterpret_cast<T*>(storage)); }
+    };
+
+    std::size_t mask;
+    std::unique_ptr<cell[]> cells;
+    alignas(std::hardware_destructive_interference_size) std::atomic<std::size_t> enqueuePos{0};
+    alignas(std::hardware_destructive_interference_size) std::atomic<std::size_t> dequeuePos{0};
+
+public:
+    explicit ring(std::size_t minCapacity)
+        : mask(std::bit_ceil(std::max<std::size_t>(minCapacity, 2)) - 1), cells(new cell[mask + 1]) {
+        for (std::size_t i = 0; i <= mask; ++i) cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+    ring(ring const&) = delete;
+    ring& operator=(ring const&) = delete;
+    ~ring() {
+        std::size_t const e = enqueuePos.load(std::memory_order_relaxed);
+        for (std::size_t pos = dequeuePos.load(std::memory_order_relaxed); pos != e; ++pos)
+            std::destroy_at(cells[pos & mask].item());
+    }
+
+    // moves up to n items from `first` into free cells, returns how many
+    template <class It>
+    std::size_t try_push_n(It first, std::size_t n) {
+        // with n == 0 no cell is ever counted, the loop below would spin
+        if (n == 0) return 0;
+        std::size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            // cells stay free until enqueuePos passes them, so the ones
+            // counted here are still free if the CAS succeeds
+            std::size_t k = 0;
+            while (k < n && cells[(pos + k) & mask].seq.load(std::memory_order_acquire) == pos + k) ++k;
+            if (k == 0) {
+                auto const diff = static_cast<std::intptr_t>(cells[pos & mask].seq.load(std::memory_order_acquire))
+                                  - static_cast<std::intptr_t>(pos);
+                if (diff < 0) return 0;     // full
+                pos = enqueuePos.load(std::memory_order_relaxed);
+                continue;
+            }
+            if (!enqueuePos.compare_exchange_weak(pos, pos + k, std::memory_order_relaxed)) continue;
+            for (std::size_t i = 0; i < k; ++i, ++first) {
+                cell& c = cells[(pos + i) & mask];
+                ::new (static_cast<void*>(c.storage)) T(std::move(*first));
+                c.seq.store(pos + i + 1, std::memory_order_release);
+            }
+            return k;
+        }
+    }
+
+    // moves up to n items to the back of out, returns how many
+    std::size_t try_pop_n(std::vector<T>& out, std::size_t n) {
+        if (n == 0) return 0;
+        std::size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            std::size_t k = 0;
+            while (k < n && cells[(pos + k) & mask].seq.load(std::memory_order_acquire) == pos + k + 1) ++k;
+            if (k == 0) {
+                auto const diff = static_cast<std::intptr_t>(cells[pos & mask].seq.load(std::memory_order_acquire))
+                                  - static_cast<std::intptr_t>(pos + 1);
+                if (diff < 0) return 0;     // empty
+                pos = dequeuePos.load(std::memory_order_relaxed);
+                continue;
+            }
+            if (!dequeuePos.compare_exchange_weak(pos, pos + k, std::memory_order_relaxed)) continue;
+            for (std::size_t i = 0; i < k; ++i) {
+                cell& c = cells[(pos + i) & mask];
+                out.push_back(std::move(*c.item()));
+                std::destroy_at(c.item());
+                c.seq.store(pos + i + mask + 1, std::memory_order_release);
+            }
+            return k;
+        }
+    }
+
+    std::size_t capacity() const noexcept { return mask + 1; }
+
+    // approximate
+    std::size_t size() const noexcept {
+        std::size_t const e = enqueuePos.load(std::memory_order_relaxed);
+        std::size_t const d = dequeuePos.load(std::memory_order_relaxed);
+        return e > d ? e - d : 0;
+    }
+};
+
+template <class T>
+struct unwrap_optional { using type = T; };
+template <class T>
+struct unwrap_optional<std::optional<T>> { using type = T; };
+
+}   // namespace pipeline_detail
+
+// what the stages share: the pool, the options and the completion count
+class pipeline_core {
+    template <class In>
+    friend class pipeline_node;
+    template <class In, class F>
+    friend class pipeline_stage;
+
+protected:
+    struct node_base {
+        pipeline_core& core;
+        stage_mode mode;
+        unsigned int limit;
+        std::atomic<unsigned int> active{0};
+        std::atomic<bool> blocked{false};
+        node_base* prev = nullptr;
+        std::atomic<std::uint64_t> items{0};
+        std::atomic<std::uint64_t> batches{0};
+        std::atomic<std::uint64_t> stalls{0};
+
+        node_base(pipeline_core& c, stage_mode m)
+            : core(c), mode(m),
+              limit(m == stage_mode::serial ? 1
+                    : c.options.maxParallelism ? c.options.maxParallelism
+                    : std::max(c.pool.numWorkers(), 1u)) {}
+        virtual ~node_base() = default;
+
+        virtual void run() = 0;
+        // worth starting a task for, racy
+        virtual bool has_work() const = 0;
+        virtual std::size_t queued() const noexcept = 0;
+        virtual std::size_t capacity() const noexcept = 0;
+
+        bool try_acquire() noexcept {
+            unsigned int a = active.load(std::memory_order_relaxed);
+            while (a < limit) {
+                if (active.compare_exchange_weak(a, a + 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+                    return true;
+            }
+            return false;
+        }
+
+        // after items were pushed into this stage or space was freed for a
+        // blocked one; pairs with the fence in run() so that either the
+        // running task sees the items or this sees it gone
+        void schedule() {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!try_acquire()) return;
+            core.outstanding.fetch_add(1, std::memory_order_relaxed);
+            core.pool.post([this] { run(); });
+        }
+
+        // a stage task: `step` flushes what a full ring left over or moves
+        // one batch, false when there was nothing to do
+        template <class Step>
+        void run_loop(Step&& step) {
+            constexpr int stepsPerTask = 16;
+            for (int steps = 0;; ++steps) {
+                if (steps == stepsPerTask) {
+                    // yield the worker to other stages, the task count moves
+                    // over to the re-posted task
+                    core.pool.post([this] { run(); });
+                    return;
+                }
+                if (step()) continue;
+                active.fetch_sub(1, std::memory_order_seq_cst);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (!has_work() || !try_acquire()) break;
+            }
+            core.done_with(1);
+        }
+
+        // input items were taken out, a blocked previous stage may go on
+        void wake_prev() {
+            if (!prev) return;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (prev->blocked.load(std::memory_order_relaxed)) prev->schedule();
+        }
+    };
+
+    ThreadPool& pool;
+    pipeline_options options;
+    std::vector<std::unique_ptr<node_base>> nodes;
+    std::chrono::steady_clock::time_point created = std::chrono::steady_clock::now();
+    // items in flight plus stage tasks alive plus one until close(), done
+    // once zero; whoever takes it to zero touches nothing else but done
+    std::atomic<std::size_t> outstanding{1};
+    std::atomic<bool> closed{false};
+    // 0 while running, 2 while notifying, 1 once notify_all() returned: the
+    // pipeline may be destroyed as soon as join() sees 1
+    std::atomic<std::uint32_t> done{0};
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+
+    pipeline_core(ThreadPool& p, pipeline_options const& o) : pool(p), options(o) {
+        options.batch = std::max<std::size_t>(options.batch, 1);
+    }
+
+    void done_with(std::size_t n) noexcept {
+        if (outstanding.fetch_sub(n, std::memory_order_acq_rel) != n) return;
+        done.store(2, std::memory_order_release);
+        done.notify_all();
+        done.store(1, std::memory_order_release);
+    }
+
+    void fail() noexcept {
+        bool expected = false;
+        // published to the waiter by done_with
+        if (failed.compare_exchange_strong(expected, true, std::memory_order_relaxed))
+            error = std::current_exception();
+    }
+
+    void join() noexcept {
+        close();
+        for (;;) {
+            std::uint32_t const d = done.load(std::memory_order_acquire);
+            if (d == 1) break;
+            if (d == 2) std::this_thread::yield();
+            else if (!pool.tryRunPendingTask()) done.wait(0, std::memory_order_acquire);
+        }
+    }
+
+public:
+    pipeline_core(pipeline_core const&) = delete;
+    pipeline_core& operator=(pipeline_core const&) = delete;
+
+    // no more push(), wait() returns once the items pushed so far are through
+    void close() noexcept {
+        // drops the reference that kept the pipeline open
+        if (!closed.exchange(true, std::memory_order_relaxed)) done_with(1);
+    }
+
+    // closes, blocks until every item went through, rethrows the first
+    // exception of a stage
+    void wait() {
+        join();
+        if (auto e = std::exchange(error, nullptr)) std::rethrow_exception(e);
+    }
+
+    std::vector<pipeline_stage_stats> stats() const {
+        std::chrono::duration<double> const elapsed = std::chrono::steady_clock::now() - created;
+        std::vector<pipeline_stage_stats> res;
+        for (auto const& n : nodes) {
+            std::uint64_t const items = n->items.load(std::memory_order_relaxed);
+            res.push_back({n->mode, items, n->batches.load(std::memory_order_relaxed),
+                           n->stalls.load(std::memory_order_relaxed), n->queued(), n->capacity(),
+                           elapsed.count() > 0 ? static_cast<double>(items) / elapsed.count() : 0.0});
+        }
+        return res;
+    }
+};
+
+// a stage as seen from the stage before it: its input ring
+template <class In>
+class pipeline_node : public pipeline_core::node_base {
+    template <class, class>
+    friend class pipeline_stage;
+    template <class>
+    friend class pipeline;
+
+protected:
+    pipeline_detail::ring<In> input;
+
+    pipeline_node(pipeline_core& c, stage_mode m) : node_base(c, m), input(c.options.capacity) {}
+
+    std::size_t queued() const noexcept override { return input.size(); }
+    std::size_t capacity() const noexcept override { return input.capacity(); }
+};
+
+template <class In, class F>
+class pipeline_stage final : public pipeline_node<In> {
+    using Result = std::invoke_result_t<F&, In>;
+    using Out = typename pipeline_detail::unwrap_optional<Result>::type;
+    static constexpr bool isSink = std::is_void_v<Out>;
+    using OutItem = std::conditional_t<isSink, std::monostate, Out>;
+
+    template <class>
+    friend class pipeline;
+    template <class, class>
+    friend class pipeline_stage;
+
+    F f;
+    pipeline_node<OutItem>* next = nullptr;
+    // outputs that didn't fit into the next ring
+    std::mutex stalledLock;
+    std::vector<OutItem> stalled;
+
+    pipeline_stage(pipeline_core& c, stage_mode m, F fn) : pipeline_node<In>(c, m), f(std::move(fn)) {}
+
+    bool flush_stalled() {
+        std::lock_guard lk(stalledLock);
+        // another task flushed them already
+        if (stalled.empty()) {
+            this->blocked.store(false, std::memory_order_relaxed);
+            return true;
+        }
+        std::size_t const pushed = next->input.try_push_n(stalled.begin(), stalled.size());
+        stalled.erase(stalled.begin(), stalled.begin() + static_cast<std::ptrdiff_t>(pushed));
+        if (pushed) next->schedule();
+        if (!stalled.empty()) return false;
+        this->blocked.store(false, std::memory_order_relaxed);
+        return true;
+    }
+
+    void deliver(std::vector<OutItem>& items) {
+        std::size_t const pushed = next->input.try_push_n(items.begin(), items.size());
+        if (pushed) next->schedule();
+        if (pushed == items.size()) return;
+        this->stalls.fetch_add(1, std::memory_order_relaxed);
+        {
+            std::lock_guard lk(stalledLock);
+            stalled.insert(stalled.end(), std::make_move_iterator(items.begin() + static_cast<std::ptrdiff_t>(pushed)),
+                           std::make_move_iterator(items.end()));
+            this->blocked.store(true, std::memory_order_relaxed);
+        }
+        // the next stage may have made room before it could see the flag
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        flush_stalled();
+    }
+
+    bool step(std::vector<In>& items, std::vector<OutItem>& results) {
+        if constexpr (!isSink) {
+            if (this->blocked.load(std::memory_order_acquire) && !flush_stalled()) return false;
+        }
+        items.clear();
+        if (this->input.try_pop_n(items, this->core.options.batch) == 0) return false;
+        this->wake_prev();
+        this->items.fetch_add(items.size(), std::memory_order_relaxed);
+        this->batches.fetch_add(1, std::memory_order_relaxed);
+
+        results.clear();
+        std::size_t finished = 0;
+        for (auto& item : items) {
+            if (this->core.failed.load(std::memory_order_relaxed)) {
+                ++finished;
+                continue;
+            }
+            try {
+                if constexpr (isSink) {
+                    std::invoke(f, std::move(item));
+                    ++finished;
+                }
+                else if constexpr (!std::is_same_v<Result, Out>) {
+                    if (auto r = std::invoke(f, std::move(item))) results.push_back(std::move(*r));
+                    else ++finished;
+                }
+                else {
+                    results.push_back(std::invoke(f, std::move(item)));
+                }
+            }
+            catch (...) {
+                this->core.fail();
+                ++finished;
+            }
+        }
+        if constexpr (!isSink) {
+            if (!results.empty()) {
+                if (next) deliver(results);
+                else finished += results.size();
+            }
+        }
+        if (finished) this->core.done_with(finished);
+        return true;
+    }
+
+    void run() override {
+        // per task, tasks of a parallel stage run concurrently
+        std::vector<In> items;
+        std::vector<OutItem> results;
+        items.reserve(this->core.options.batch);
+        results.reserve(this->core.options.batch);
+        this->run_loop([&] { return step(items, results); });
+    }
+
+    bool has_work() const override {
+        if constexpr (!isSink) {
+            if (this->blocked.load(std::memory_order_relaxed))
+                return next->input.size() < next->input.capacity();
+        }
+        return this->input.size() != 0;
+    }
+
+public:
+    // appends a stage fed by this one's results
+    template <class G>
+        requires (!isSink) && std::invocable<std::decay_t<G>&, OutItem>
+    auto& then(stage_mode mode, G&& g) {
+        using Next = pipeline_stage<OutItem, std::decay_t<G>>;
+        auto node = std::unique_ptr<Next>(new Next(this->core, mode, std::forward<G>(g)));
+        Next& res = *node;
+        res.prev = this;
+        this->core.nodes.push_back(std::move(node));
+        next = &res;
+        return res;
+    }
+};
+
+template <class In>
+class pipeline : public pipeline_core {
+    pipeline_node<In>* first = nullptr;
+
+public:
+    explicit pipeline(ThreadPool& p, pipeline_options const& o = {}) : pipeline_core(p, o) {}
+    ~pipeline() { join(); }
+
+    // the first stage
+    template <class F>
+        requires std::invocable<std::decay_t<F>&, In>
+    auto& then(stage_mode mode, F&& f) {
+        using Stage = pipeline_stage<In, std::decay_t<F>>;
+        auto node = std::unique_ptr<Stage>(new Stage(*this, mode, std::forward<F>(f)));
+        Stage& res = *node;
+        nodes.push_back(std::move(node));
+        first = &res;
+        return res;
+    }
+
+    // moves up to n items in without waiting, returns how many
+    template <std::input_iterator It>
+    std::size_t try_push_n(It items, std::size_t n) {
+        outstanding.fetch_add(n, std::memory_order_relaxed);
+        std::size_t const pushed = first->input.try_push_n(items, n);
+        if (pushed) first->schedule();
+        if (pushed != n) done_with(n - pushed);
+        return pushed;
+    }
+
+    bool try_push(In& item) { return try_push_n(&item, 1) == 1; }
+
+    // waits while the first ring is full, running pool tasks meanwhile
+    template <std::input_iterator It>
+    void push_n(It items, std::size_t n) {
+        while (n) {
+            std::size_t const pushed = try_push_n(items, n);
+            std::advance(items, pushed);
+            n -= pushed;
+            if (n && !pool.tryRunPendingTask()) std::this_thread::yield();
+        }
+    }
+
+    void push(In item) { push_n(&item, 1); }
+};
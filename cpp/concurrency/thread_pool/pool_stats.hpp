@@ -0,0 +1,57 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include "cpu_topology.hpp"
+#include "latency_histogram.hpp"
+
+/*
+Scheduler instrumentation of ThreadPool
+- every counter has a single writer (its worker), so an increment is a relaxed
+  load + store on a cache line nobody else writes, readers take a snapshot
+  that may be slightly stale; this is cheap enough to leave on in production
+- compile with -DTHREAD_POOL_STATS=0 to remove the counters, the clock reads
+  and the histograms entirely, stat_counter then is an empty type
+*/
+#ifndef THREAD_POOL_STATS
+#define THREAD_POOL_STATS 1
+#endif
+
+inline constexpr bool threadPoolStats = THREAD_POOL_STATS;
+
+#if THREAD_POOL_STATS
+class stat_counter {
+    std::atomic<std::uint64_t> value{0};
+public:
+    void add(std::uint64_t n = 1) noexcept {
+        value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+    std::uint64_t get() const noexcept { return value.load(std::memory_order_relaxed); }
+};
+#else
+class stat_counter {
+public:
+    void add(std::uint64_t = 1) noexcept {}
+    std::uint64_t get() const noexcept { return 0; }
+};
+#endif
+
+// snapshot returned by ThreadPool::stats()
+struct ThreadPoolStats {
+    struct Worker {
+        std::uint64_t localPops = 0;
+        std::uint64_t globalPops = 0;
+        std::array<std::uint64_t, num_cpu_localities> steals{};    // by cpu_locality
+        std::uint64_t stolenTasks = 0;      // tasks moved by those steals, see steal_half
+        std::uint64_t failedSteals = 0;     // victim attempts that came back empty
+        std::uint64_t tasksRun = 0;
+        std::int64_t queueDepth = 0;        // approximate, all lanes
+        std::chrono::nanoseconds spinning{0};
+        std::chrono::nanoseconds parked{0};
+    };
+    std::vector<Worker> workers;
+    // sampled: one task out of ThreadPoolOptions::runTimeSampleInterval
+    latency_histogram::snapshot taskRunTime;
+};
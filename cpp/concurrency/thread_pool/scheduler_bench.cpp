@@ -0,0 +1,259 @@
+/*
+standard scheduler workloads on ThreadPool and on a baseline pool with a
+single mutex-protected global queue, for 1 worker up to the core count
+- "fib": fib(n) as a task tree, every call for n >= 2 posts two tasks,
+  tiny tasks and lots of them
+- "uts": unbalanced tree search, the root has many children, every other
+  node has m children with probability q (m * q just below 1)
+- "skewed": parallel for over 2^16 iterations whose cost grows linearly with
+  the index, split recursively down to a grain of 64
+- "ping-pong": one chain of tasks per worker, each task posts the next one,
+  so a chain has only one task queued at a time and every hop is a handoff
+- "flood": 4 threads outside the pool post trivial tasks as fast as they can
+report: tasks/s, latency from post to start of the task (p50 / p99 / p99.9,
+log2 buckets) and for ThreadPool the fraction of tasks that were stolen
+
+build: g++ -std=c++20 -O2 -pthread scheduler_bench.cpp
+*/
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "latency_histogram.hpp"
+#include "thread_pool.hpp"
+#include "unique_task.hpp"
+
+// what ThreadPool replaced: one FIFO behind a mutex, workers sleep on a
+// condition variable
+class GlobalQueuePool {
+    std::mutex m;
+    std::condition_variable_any cv;
+    std::deque<unique_task> tasks;
+    std::vector<std::jthread> threads;
+
+public:
+    explicit GlobalQueuePool(unsigned int numThreads) {
+        for (unsigned int i = 0; i < numThreads; ++i) {
+            threads.emplace_back([this](std::stop_token st) {
+                for (;;) {
+                    unique_task task;
+                    {
+                        std::unique_lock lk(m);
+                        if (!cv.wait(lk, st, [this] { return !tasks.empty(); })) return;
+                        task = std::move(tasks.front());
+                        tasks.pop_front();
+                    }
+                    task();
+                }
+            });
+        }
+    }
+
+    ~GlobalQueuePool() {
+        for (auto& t : threads) t.request_stop();
+        threads.clear();
+    }
+
+    template <class F>
+    void post(F&& f) {
+        {
+            std::lock_guard lk(m);
+            tasks.emplace_back(std::forward<F>(f));
+        }
+        cv.notify_one();
+    }
+};
+
+inline std::int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// one histogram per thread that runs tasks, single writer each
+class LatencyRecorder {
+    static constexpr std::size_t maxThreads = 256;
+    std::vector<latency_histogram> histograms{maxThreads};
+    std::atomic<std::size_t> nextSlot{0};
+
+public:
+    void record(std::int64_t ns) {
+        thread_local LatencyRecorder* owner = nullptr;
+        thread_local std::size_t slot = 0;
+        if (owner != this) {
+            owner = this;
+            slot = nextSlot.fetch_add(1, std::memory_order_relaxed) % maxThreads;
+        }
+        histograms[slot].record(ns);
+    }
+
+    latency_histogram::snapshot snapshot() const {
+        latency_histogram::snapshot res;
+        for (auto const& h : histograms) h.add_to(res);
+        return res;
+    }
+};
+
+// counts outstanding tasks, the last one wakes main
+class Completion {
+    std::atomic<std::int64_t> pending{0};
+    std::atomic<std::uint32_t> done{0};
+public:
+    void add(std::int64_t n) { pending.fetch_add(n, std::memory_order_relaxed); }
+    void finish() {
+        if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            done.store(1, std::memory_order_release);
+            done.notify_all();
+        }
+    }
+    void wait() {
+        while (!done.load(std::memory_order_acquire)) done.wait(0, std::memory_order_acquire);
+    }
+};
+
+inline std::uint64_t spin(std::uint64_t x, int iterations) {
+    for (int i = 0; i < iterations; ++i) x = x * 6364136223846793005ull + 1442695040888963407ull;
+    return x;
+}
+
+inline std::uint64_t mix(std::uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    return x;
+}
+
+std::atomic<std::uint64_t> sink{0};
+
+// the workloads only use post(f), so they run unchanged on both pools
+template <class Pool>
+struct Run {
+    Completion completion;
+    LatencyRecorder latency;
+    std::atomic<std::int64_t> tasks{0};
+    // last, so its workers are joined before the rest goes away
+    Pool pool;
+
+    explicit Run(unsigned threads) : pool(threads) {}
+
+    template <class F>
+    void spawn(F f) {
+        completion.add(1);
+        pool.post([this, f = std::move(f), posted = nowNs()]() mutable {
+            latency.record(nowNs() - posted);
+            tasks.fetch_add(1, std::memory_order_relaxed);
+            f();
+            completion.finish();
+        });
+    }
+
+    void fib(int n) {
+        if (n < 2) return;
+        spawn([this, n] { fib(n - 1); });
+        spawn([this, n] { fib(n - 2); });
+    }
+
+    void uts(std::uint64_t id, bool root) {
+        constexpr int rootChildren = 2000, m = 4, work = 200;
+        constexpr double q = 0.2475;
+        sink.fetch_add(spin(id, work) & 1, std::memory_order_relaxed);
+        int children = root ? rootChildren : 0;
+        if (!root && static_cast<double>(mix(id) >> 11) * 0x1p-53 < q) children = m;
+        for (int i = 0; i < children; ++i) {
+            std::uint64_t const child = mix(id * 31 + i + 1);
+            spawn([this, child] { uts(child, false); });
+        }
+    }
+
+    void skewed(std::uint32_t b, std::uint32_t e) {
+        constexpr std::uint32_t grain = 64;
+        while (e - b > grain) {
+            std::uint32_t const mid = b + (e - b) / 2;
+            spawn([this, mid, e] { skewed(mid, e); });
+            e = mid;
+        }
+        std::uint64_t x = 0;
+        for (std::uint32_t i = b; i < e; ++i) x += spin(i, static_cast<int>(i / 256));
+        sink.fetch_add(x & 1, std::memory_order_relaxed);
+    }
+
+    void ping(int remaining) {
+        if (remaining > 0) spawn([this, remaining] { ping(remaining - 1); });
+    }
+};
+
+template <class Pool>
+std::int64_t runWorkload(char const* workload, Run<Pool>& run, unsigned threads) {
+    std::string_view const w = workload;
+    if (w == "fib") {
+        run.spawn([&] { run.fib(25); });
+    }
+    else if (w == "uts") {
+        run.spawn([&] { run.uts(1, true); });
+    }
+    else if (w == "skewed") {
+        run.spawn([&] { run.skewed(0, 1u << 16); });
+    }
+    else if (w == "ping-pong") {
+        for (unsigned i = 0; i < threads; ++i) run.spawn([&] { run.ping(50'000); });
+    }
+    else {
+        constexpr int producers = 4, perProducer = 100'000;
+        // holds completion open until every producer is done
+        run.completion.add(1);
+        {
+            std::vector<std::jthread> outside;
+            for (int p = 0; p < producers; ++p) {
+                outside.emplace_back([&] {
+                    for (int i = 0; i < perProducer; ++i) run.spawn([] {});
+                });
+            }
+        }
+        run.completion.finish();
+    }
+    run.completion.wait();
+    return run.tasks.load();
+}
+
+template <class Pool>
+void report(char const* workload, char const* name, unsigned threads) {
+    Run<Pool> run(threads);
+    auto const start = std::chrono::steady_clock::now();
+    std::int64_t const tasks = runWorkload(workload, run, threads);
+    std::chrono::duration<double> const elapsed = std::chrono::steady_clock::now() - start;
+    auto const lat = run.latency.snapshot();
+    std::printf("%-9s %-12s %3u workers %12.0f tasks/s  latency p50 %8lld p99 %8lld p99.9 %9lld ns",
+                workload, name, threads, tasks / elapsed.count(),
+                static_cast<long long>(lat.percentile(0.5).count()),
+                static_cast<long long>(lat.percentile(0.99).count()),
+                static_cast<long long>(lat.percentile(0.999).count()));
+    if constexpr (std::is_same_v<Pool, ThreadPool>) {
+        std::uint64_t stolen = 0, ran = 0;
+        for (auto const& w : run.pool.stats().workers) {
+            stolen += w.stolenTasks;
+            ran += w.tasksRun;
+        }
+        std::printf("  stolen %5.1f%%", ran ? 100.0 * static_cast<double>(stolen) / static_cast<double>(ran) : 0.0);
+    }
+    std::printf("\n");
+}
+
+int main() {
+    std::vector<unsigned> counts{1, 2, 4, 8, std::max(1u, std::jthread::hardware_concurrency())};
+    std::ranges::sort(counts);
+    counts.erase(std::unique(counts.begin(), counts.end()), counts.end());
+    for (char const* workload : {"fib", "uts", "skewed", "ping-pong", "flood"}) {
+        for (unsigned threads : counts) {
+            report<GlobalQueuePool>(workload, "global queue", threads);
+            report<ThreadPool>(workload, "ThreadPool", threads);
+        }
+    }
+    return sink.load() == 42;
+}
@@ -0,0 +1,142 @@
+/*
+work stealing policies of ThreadPool on unbalanced recursive workloads
+- "tree": unbalanced tree search, every node spawns its children as tasks;
+  the root has many children, every other node has `m` children with
+  probability q (m * q just below 1), so subtree sizes vary wildly
+- "fan-out": a single task spawns every other task into its own deque, all
+  other workers can only get work by stealing
+- policies: fixed or random victim order, steal one task or up to half of
+  the victim's deque (ThreadPoolOptions::randomizeVictims / maxStealBatch)
+
+build: g++ -std=c++20 -O2 -pthread steal_bench.cpp
+*/
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include "thread_pool.hpp"
+
+struct Policy {
+    char const* name;
+    bool randomizeVictims;
+    unsigned int maxStealBatch;
+};
+
+constexpr Policy policies[] = {
+    {"fixed order, steal one", false, 1},
+    {"random, steal one", true, 1},
+    {"fixed order, steal half", false, 32},
+    {"random, steal half", true, 32},
+};
+
+// counts outstanding tasks, the last one wakes main
+class Completion {
+    std::atomic<std::int64_t> pending{0};
+    std::atomic<std::uint32_t> done{0};
+public:
+    void add(std::int64_t n) { pending.fetch_add(n, std::memory_order_relaxed); }
+    void finish() {
+        if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            done.store(1, std::memory_order_release);
+            done.notify_all();
+        }
+    }
+    void wait() {
+        while (!done.load(std::memory_order_acquire)) done.wait(0, std::memory_order_acquire);
+    }
+};
+
+// some work per task so that scheduling overhead isn't all we measure
+inline std::uint64_t spin(std::uint64_t x, int iterations) {
+    for (int i = 0; i < iterations; ++i) x = x * 6364136223846793005ull + 1442695040888963407ull;
+    return x;
+}
+
+std::atomic<std::uint64_t> sink{0};
+
+struct Tree {
+    static constexpr int rootChildren = 2000;
+    static constexpr int m = 4;
+    static constexpr double q = 0.2475;
+    static constexpr int work = 200;
+
+    ThreadPool& pool;
+    Completion& completion;
+    std::atomic<std::int64_t> nodes{0};
+
+    static std::uint64_t mix(std::uint64_t x) {
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdull;
+        x ^= x >> 33;
+        return x;
+    }
+
+    void visit(std::uint64_t id, bool root) {
+        nodes.fetch_add(1, std::memory_order_relaxed);
+        sink.fetch_add(spin(id, work) & 1, std::memory_order_relaxed);
+        int children = root ? rootChildren : 0;
+        if (!root && static_cast<double>(mix(id) >> 11) * 0x1p-53 < q) children = m;
+        completion.add(children);
+        for (int i = 0; i < children; ++i) {
+            std::uint64_t const child = mix(id * 31 + i + 1);
+            pool.submit([this, child] { visit(child, false); });
+        }
+        completion.finish();
+    }
+};
+
+template <class F>
+void report(char const* workload, Policy const& policy, unsigned threads, F&& body) {
+    ThreadPool pool(ThreadPoolOptions{
+        .numThreads = threads,
+        .randomizeVictims = policy.randomizeVictims,
+        .maxStealBatch = policy.maxStealBatch,
+    });
+    auto const start = std::chrono::steady_clock::now();
+    std::int64_t const tasks = body(pool);
+    std::chrono::duration<double> const elapsed = std::chrono::steady_clock::now() - start;
+    std::uint64_t steals = 0, stolen = 0, failed = 0;
+    for (auto const& w : pool.stats().workers) {
+        for (auto s : w.steals) steals += s;
+        stolen += w.stolenTasks;
+        failed += w.failedSteals;
+    }
+    std::printf("%-8s %-24s %3u workers %8.1f ms %12.0f tasks/s %9llu steals %9llu stolen %11llu failed\n",
+                workload, policy.name, threads, elapsed.count() * 1e3, tasks / elapsed.count(),
+                static_cast<unsigned long long>(steals), static_cast<unsigned long long>(stolen),
+                static_cast<unsigned long long>(failed));
+}
+
+int main() {
+    for (unsigned threads : {2u, 4u, std::jthread::hardware_concurrency()}) {
+        for (auto const& policy : policies) {
+            report("tree", policy, threads, [](ThreadPool& pool) {
+                Completion completion;
+                Tree tree{pool, completion};
+                completion.add(1);
+                pool.submit([&] { tree.visit(1, true); });
+                completion.wait();
+                return tree.nodes.load();
+            });
+        }
+        for (auto const& policy : policies) {
+            report("fan-out", policy, threads, [](ThreadPool& pool) {
+                constexpr std::int64_t n = 200'000;
+                Completion completion;
+                completion.add(n + 1);
+                pool.submit([&] {
+                    for (std::int64_t i = 0; i < n; ++i) {
+                        pool.submit([&, i] {
+                            sink.fetch_add(spin(i, 200) & 1, std::memory_order_relaxed);
+                            completion.finish();
+                        });
+                    }
+                    completion.finish();
+                });
+                completion.wait();
+                return n;
+            });
+        }
+    }
+    return sink.load() == 42;
+}
@@ -0,0 +1,136 @@
+#pragma once
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <type_traits>
+#include "thread_pool.hpp"
+
+/*
+Serial executor on a ThreadPool: tasks posted to the same strand run one at a
+time, in the order they were posted, on whatever worker picks the strand up
+- replaces a mutex inside every task, which blocks the worker while another
+  task of the same key holds it; a strand never blocks a worker
+- incoming: lock-free intrusive LIFO of task_nodes, a producer links its node
+  and CASes the head; the runner takes the whole list with one exchange and
+  reverses it, which restores posting order
+- pending counts posted tasks that haven't run yet, a producer counts its
+  task before it links it; the producer that moves pending from 0 to 1 posts
+  the strand's runner to the pool, so a strand is queued at most once and
+  occupies no worker while it has nothing to do
+- the runner runs up to `batch` tasks per scheduling slot, then re-posts
+  itself if tasks are left, so one busy strand doesn't monopolize a worker
+- the strand must outlive its tasks; post() tasks must not throw, submit()
+  reports exceptions through the future
+*/
+class strand {
+    ThreadPool& pool;
+    TaskPriority priority;
+    unsigned int batch;
+    std::atomic<task_node*> incoming{nullptr};
+    alignas(std::hardware_destructive_interference_size) std::atomic<std::size_t> pending{0};
+    // runner only, the tasks taken from incoming in FIFO order
+    task_node* ready = nullptr;
+    task_node runner;
+
+    void push(task_node* node) {
+        // counted before it is linked, so pending never drops below the
+        // number of linked nodes; the runner may find fewer nodes than
+        // counted, see run()
+        bool const first = pending.fetch_add(1, std::memory_order_acq_rel) == 0;
+        task_node* head = incoming.load(std::memory_order_relaxed);
+        do {
+            node->next = head;
+        } while (!incoming.compare_exchange_weak(head, node, std::memory_order_release,
+                                                 std::memory_order_relaxed));
+        if (first) pool.post(&runner, priority);
+    }
+
+    void run() {
+        std::size_t ran = 0;
+        while (ran < batch) {
+            if (!ready) {
+                task_node* list = incoming.exchange(nullptr, std::memory_order_acquire);
+                while (list) {
+                    task_node* next = list->next;
+                    list->next = ready;
+                    ready = list;
+                    list = next;
+                }
+                if (!ready) {
+                    if (ran) break;
+                    // pending is nonzero, so a producer counted its task and
+                    // is one CAS away from linking it: wait here instead of
+                    // re-posting the runner through the pool in a loop
+                    for (unsigned int spins = 0; !incoming.load(std::memory_order_relaxed); ++spins) {
+                        if (spins < 64) cpu_relax();
+                        else std::this_thread::yield();
+                    }
+                    continue;
+                }
+            }
+            task_node* task = ready;
+            ready = task->next;
+            task->run();
+            ++ran;
+        }
+        // tasks left, or counted by a producer that hasn't linked them yet
+        // (that one is found by the next slot)
+        if (pending.fetch_sub(ran, std::memory_order_acq_rel) != ran) pool.post(&runner, priority);
+    }
+
+public:
+    explicit strand(ThreadPool& p, TaskPriority prio = TaskPriority::normal, unsigned int batchSize = 32)
+        : pool(p), priority(prio), batch(std::max(batchSize, 1u)) {
+        runner.fn = unique_task([this] { run(); });
+        // the runner is reused, nothing to release
+        runner.release = [](task_node*) noexcept {};
+    }
+    strand(strand const&) = delete;
+    strand& operator=(strand const&) = delete;
+
+    template <class F>
+        requires std::invocable<std::decay_t<F>&>
+    void post(F&& f) {
+        push(make_task_node(std::forward<F>(f)));
+    }
+
+    template <std::invocable F>
+    auto submit(F&& f) -> pool_future<std::invoke_result_t<std::decay_t<F>&>> {
+        using Res = std::invoke_result_t<std::decay_t<F>&>;
+        auto* state = task_state<Res>::create(std::forward<F>(f));
+        pool_future<Res> res(state);
+        push(state);
+        return res;
+    }
+
+    // no task queued or running, racy unless posting has stopped
+    bool idle() const noexcept { return pending.load(std::memory_order_acquire) == 0; }
+};
+
+/*
+Fixed set of strands, a key is hashed to one of them: tasks of the same key
+keep their order and never run concurrently, for keys that are too many or
+too short-lived to give each its own strand (connections, accounts); keys
+that collide are serialized with each other as well, so use a few times more
+strands than workers
+*/
+template <class Key, class Hash = std::hash<Key>>
+class strand_group {
+    std::deque<strand> strands;     // strand is not movable
+    Hash hash;
+public:
+    strand_group(ThreadPool& pool, std::size_t numStrands, TaskPriority prio = TaskPriority::normal) {
+        for (std::size_t i = 0; i < std::max<std::size_t>(numStrands, 1); ++i) strands.emplace_back(pool, prio);
+    }
+
+    strand& operator[](Key const& key) noexcept { return strands[hash(key) % strands.size()]; }
+
+    template <class F>
+    void post(Key const& key, F&& f) { (*this)[key].post(std::forward<F>(f)); }
+
+    template <class F>
+    auto submit(Key const& key, F&& f) { return (*this)[key].submit(std::forward<F>(f)); }
+};
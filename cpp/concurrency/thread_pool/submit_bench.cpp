@@ -0,0 +1,92 @@
+/*
+tasks/sec and allocations/task of ThreadPool::submit
+- "before": what submit used to build per task, a std::stop_source, a
+  std::packaged_task and a std::function (the packaged_task has to be put
+  behind a shared_ptr since std::function needs a copyable target)
+- "after": task_state from the block pool holding a unique_task
+- end to end, submit + future per task vs post into a task_group, which has
+  no result channel at all
+
+build: g++ -std=c++20 -O2 -pthread submit_bench.cpp
+*/
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <future>
+#include <memory>
+#include <new>
+#include "task_group.hpp"
+#include "thread_pool.hpp"
+
+static std::atomic<std::size_t> allocations{0};
+
+void* operator new(std::size_t n) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+template <class F>
+void report(char const* name, std::size_t n, F&& body) {
+    auto const allocsBefore = allocations.load();
+    auto const start = std::chrono::steady_clock::now();
+    body();
+    std::chrono::duration<double> const elapsed = std::chrono::steady_clock::now() - start;
+    std::printf("%-32s %12.0f tasks/s %6.2f allocs/task\n", name, n / elapsed.count(),
+                double(allocations.load() - allocsBefore) / n);
+}
+
+int main() {
+    constexpr std::size_t n = 1'000'000;
+    long sink = 0;
+
+    // packaging only, on one thread: create, run, get
+    report("before: packaged_task+function", n, [&] {
+        for (std::size_t i = 0; i < n; ++i) {
+            std::stop_source ssrc;
+            auto task = std::make_shared<std::packaged_task<long()>>(
+                [i, st = ssrc.get_token()] { return st.stop_requested() ? 0L : long(i); });
+            auto fut = task->get_future();
+            std::function<void()> fn([task] { (*task)(); });
+            fn();
+            sink += fut.get();
+        }
+    });
+    report("after: task_state+unique_task", n, [&] {
+        for (std::size_t i = 0; i < n; ++i) {
+            auto* state = task_state<long>::create([i] { return long(i); });
+            pool_future<long> fut(state);
+            state->run();
+            sink += fut.get();
+        }
+    });
+
+    // end to end, submitted from outside the pool
+    for (unsigned threads : {1u, 2u, 4u, std::jthread::hardware_concurrency()}) {
+        ThreadPool pool(threads);
+        std::vector<pool_future<long>> futs;
+        futs.reserve(n);
+        char name[64];
+        std::snprintf(name, sizeof(name), "pool.submit, %u workers", threads);
+        report(name, n, [&] {
+            for (std::size_t i = 0; i < n; ++i)
+                futs.push_back(pool.submit([i] { return long(i); }));
+            for (auto& f : futs) sink += f.get();
+        });
+        futs.clear();
+        std::snprintf(name, sizeof(name), "task_group.run, %u workers", threads);
+        std::atomic<long> total{0};
+        report(name, n, [&] {
+            task_group group(pool);
+            for (std::size_t i = 0; i < n; ++i)
+                group.run([i, &total] { total.fetch_add(long(i), std::memory_order_relaxed); });
+            group.wait();
+        });
+        sink += total.load();
+    }
+    return sink == 42;
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <thread>
+#include <vector>
+#include "thread_pool.hpp"
+
+/*
+Dependency graph executed on a ThreadPool
+- build once: emplace nodes, precede(a, b) adds the edge a -> b
+- run(pool) releases the nodes without predecessors, a node is released when
+  its atomic predecessor counter drops to zero
+- a finishing node runs its first ready successor inline instead of pushing
+  it, the successor typically consumes what the node just produced, so its
+  data is still in cache; the other ready successors are posted to the pool
+  where idle workers can steal them
+- the graph owns one task_node per node, created when the node is emplaced,
+  so run() allocates nothing and the graph can be run again after wait()
+- the graph must be acyclic and must not be modified or destroyed while it runs
+- if a node throws, the remaining nodes are skipped and wait() rethrows
+- done is 0 while running, 2 while the last node notifies and 1 once it
+  returned from notify_all(), only then may wait() return and the graph be
+  destroyed
+*/
+class task_graph {
+    struct node {
+        task_graph* graph;
+        unique_task work;
+        std::vector<node*> successors;
+        std::uint32_t numPredecessors = 0;
+        std::atomic<std::uint32_t> pending{0};
+        task_node qnode;    // what the pool queues, fn runs execute(this)
+    };
+
+    std::deque<node> nodes;     // stable addresses
+    ThreadPool* pool = nullptr;
+    std::atomic<std::size_t> remaining{0};
+    std::atomic<std::uint32_t> done{1};
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+
+    void execute(node* n) {
+        while (n) {
+            if (!failed.load(std::memory_order_relaxed)) {
+                try {
+                    n->work();
+                }
+                catch (...) {
+                    bool expected = false;
+                    if (failed.compare_exchange_strong(expected, true, std::memory_order_relaxed))
+                        error = std::current_exception();
+                }
+            }
+            node* next = nullptr;
+            for (node* succ : n->successors) {
+                if (succ->pending.fetch_sub(1, std::memory_order_acq_rel) != 1) continue;
+                if (!next) next = succ;
+                else pool->post(&succ->qnode);
+            }
+            finish();
+            n = next;
+        }
+    }
+
+    void finish() noexcept {
+        if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            done.store(2, std::memory_order_release);
+            done.notify_all();
+            done.store(1, std::memory_order_release);
+        }
+    }
+
+public:
+    using node_id = std::size_t;
+
+    task_graph() = default;
+    task_graph(task_graph const&) = delete;
+    task_graph& operator=(task_graph const&) = delete;
+
+    template <class F>
+        requires std::invocable<std::decay_t<F>&>
+    node_id emplace(F&& f) {
+        node& n = nodes.emplace_back();
+        n.graph = this;
+        n.work = unique_task(std::forward<F>(f));
+        n.qnode.fn = unique_task([p = &n] { p->graph->execute(p); });
+        // the node is reused by the next run, nothing to release
+        n.qnode.release = [](task_node*) noexcept {};
+        return nodes.size() - 1;
+    }
+
+    // `before` must finish before `after` starts
+    void precede(node_id before, node_id after) {
+        nodes[before].successors.push_back(&nodes[after]);
+        ++nodes[after].numPredecessors;
+    }
+
+    std::size_t size() const noexcept { return nodes.size(); }
+
+    void run(ThreadPool& p) {
+        pool = &p;
+        failed.store(false, std::memory_order_relaxed);
+        error = nullptr;
+        if (nodes.empty()) return;
+        done.store(0, std::memory_order_relaxed);
+        remaining.store(nodes.size(), std::memory_order_relaxed);
+        for (node& n : nodes) n.pending.store(n.numPredecessors, std::memory_order_relaxed);
+        // the release in post publishes the counters to the workers
+        for (node& n : nodes) {
+            if (n.numPredecessors == 0) pool->post(&n.qnode);
+        }
+    }
+
+    bool is_ready() const noexcept { return done.load(std::memory_order_acquire) == 1; }
+
+    // blocks until every node finished, rethrows the first exception
+    void wait() {
+        for (;;) {
+            std::uint32_t const d = done.load(std::memory_order_acquire);
+            if (d == 1) break;
+            if (d == 0) done.wait(0, std::memory_order_acquire);
+            else std::this_thread::yield();
+        }
+        if (error) std::rethrow_exception(error);
+    }
+};
@@ -0,0 +1,98 @@
+#pragma once
+#include <atomic>
+#include <concepts>
+#include <cstdint>
+#include <exception>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include "thread_pool.hpp"
+
+/*
+Fork-join group of fire-and-forget tasks
+- run(f) posts f through ThreadPool::post, so a task costs one pooled node
+  and nothing else: no future, no result, no reference count
+- completion is a single atomic counter of outstanding tasks, instead of
+  waiting on N futures one after the other
+- wait() runs queued pool tasks while the group isn't done, often the group's
+  own tasks, and only sleeps on the counter when there is nothing to run;
+  called from a worker this is what makes nested groups safe
+- the first exception is kept and rethrown by wait(), tasks that haven't
+  started when a task throws are skipped
+- the task that finishes last stays counted as a notifier until notify_all()
+  returned, so a waiter can't return and destroy the group under it
+- run() may be called from inside the group's tasks; the destructor waits
+*/
+class task_group {
+    ThreadPool& pool;
+    // low half: tasks not finished, high half: finish() calls still notifying
+    std::atomic<std::uint64_t> pending{0};
+    static constexpr std::uint64_t notifier = std::uint64_t{1} << 32;
+    static constexpr std::uint64_t task_mask = notifier - 1;
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+
+    void finish() noexcept {
+        std::uint64_t n = pending.load(std::memory_order_relaxed);
+        bool last;
+        do {
+            last = (n & task_mask) == 1;
+        } while (!pending.compare_exchange_weak(n, last ? n - 1 + notifier : n - 1, std::memory_order_acq_rel,
+                                                std::memory_order_relaxed));
+        if (!last) return;
+        pending.notify_all();
+        pending.fetch_sub(notifier, std::memory_order_release);
+    }
+
+    void join() noexcept {
+        for (;;) {
+            std::uint64_t const n = pending.load(std::memory_order_acquire);
+            if (n == 0) return;
+            // the last task finished, its notify_all() is about to return
+            if ((n & task_mask) == 0) std::this_thread::yield();
+            else if (!pool.tryRunPendingTask()) pending.wait(n, std::memory_order_acquire);
+        }
+    }
+
+public:
+    explicit task_group(ThreadPool& p) noexcept : pool(p) {}
+    task_group(task_group const&) = delete;
+    task_group& operator=(task_group const&) = delete;
+    ~task_group() { join(); }
+
+    template <class F>
+        requires std::invocable<std::decay_t<F>&>
+    void run(F&& f, TaskPriority priority = TaskPriority::normal) {
+        pending.fetch_add(1, std::memory_order_relaxed);
+        try {
+            pool.post([this, f = std::forward<F>(f)]() mutable {
+                if (!failed.load(std::memory_order_relaxed)) {
+                    try {
+                        f();
+                    }
+                    catch (...) {
+                        bool expected = false;
+                        // published to the waiter by the release in finish()
+                        if (failed.compare_exchange_strong(expected, true, std::memory_order_relaxed))
+                            error = std::current_exception();
+                    }
+                }
+                finish();
+            }, priority);
+        }
+        catch (...) {
+            finish();
+            throw;
+        }
+    }
+
+    // blocks until every task ran, rethrows the first exception; the group
+    // can be reused afterwards
+    void wait() {
+        join();
+        failed.store(false, std::memory_order_relaxed);
+        if (auto e = std::exchange(error, nullptr)) std::rethrow_exception(e);
+    }
+
+    bool is_ready() const noexcept { return pending.load(std::memory_order_acquire) == 0; }
+};
@@ -0,0 +1,341 @@
+#pragma once
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include "block_pool.hpp"
+#include "inplace_stop_token.hpp"
+#include "unique_task.hpp"
+
+/*
+Unit of work stored in the ThreadPool queues
+- queues only store task_node*, the Chase-Lev deque needs slots that are a
+  single atomic word, and the global queue links nodes through `next`, so
+  neither queue allocates on push
+- `release` is called exactly once per scheduling, after `fn` ran or when the
+  pool is destroyed with the task still queued; it decides what happens to the
+  node: pooled nodes destroy `fn` and free the block, nodes owned by an
+  executor (e.g. task_graph) keep `fn` so that they can be scheduled again
+*/
+struct task_node {
+    unique_task fn;
+    task_node* next = nullptr;
+    std::int64_t enqueuedNs = 0;    // steady_clock, set by the pool on schedule
+    void (*release)(task_node*) noexcept = nullptr;
+
+    void run() {
+        // fn may end the node's lifetime, e.g. a node embedded in a coroutine
+        // frame whose fn resumes that coroutine, so release is read first
+        auto const r = release;
+        fn();
+        r(this);
+    }
+
+    void discard() noexcept { release(this); }
+};
+
+/*
+What the per-worker deques hold: a task_node* or a suspended coroutine
+- a coroutine scheduled from a worker is pushed as its bare handle, so
+  resuming it costs no allocation and no indirection through unique_task
+- both pointers are at least 2-byte aligned, the low bit tells them apart,
+  so task_ref is a single word like the Chase-Lev slots require
+*/
+class task_ref {
+    std::uintptr_t bits = 0;
+
+    static constexpr std::uintptr_t coroutine_bit = 1;
+
+public:
+    task_ref() noexcept = default;
+    task_ref(std::nullptr_t) noexcept {}
+    task_ref(task_node* node) noexcept : bits(reinterpret_cast<std::uintptr_t>(node)) {}
+    explicit task_ref(std::coroutine_handle<> h) noexcept
+        : bits(reinterpret_cast<std::uintptr_t>(h.address()) | coroutine_bit) {}
+
+    explicit operator bool() const noexcept { return bits != 0; }
+
+    friend bool operator==(task_ref, task_ref) noexcept = default;
+
+    // nullptr for coroutines
+    task_node* node() const noexcept {
+        return bits & coroutine_bit ? nullptr : reinterpret_cast<task_node*>(bits);
+    }
+
+    void run() const {
+        if (bits & coroutine_bit)
+            std::coroutine_handle<>::from_address(
+                reinterpret_cast<void*>(bits & ~coroutine_bit)).resume();
+        else
+            node()->run();
+    }
+
+    // a coroutine frame belongs to whoever started the coroutine, it is
+    // neither resumed nor destroyed here
+    void discard() const noexcept {
+        if (auto* n = node()) n->discard();
+    }
+};
+
+// task_node without a result channel, its block goes back to the pool after
+// it ran
+template <class F>
+task_node* make_task_node(F&& f) {
+    void* mem = block_pool::allocate(sizeof(task_node));
+    auto* node = ::new (mem) task_node();
+    node->release = [](task_node* n) noexcept {
+        n->~task_node();
+        block_pool::deallocate(n, sizeof(task_node));
+    };
+    try {
+        node->fn = unique_task(std::forward<F>(f));
+    }
+    catch (...) {
+        node->discard();
+        throw;
+    }
+    return node;
+}
+
+template <class T>
+class pool_future;
+
+template <class T>
+class async_state;
+
+/*
+Shared state of ThreadPool::submit
+- a single pooled block holds the queued task, the result and the reference
+  count, replacing the separate allocations of std::packaged_task's shared
+  state and std::function's target
+- refs: one for the queued task_node, one for the pool_future
+- `ready` is a 32-bit word so that pool_future::wait maps to a futex wait
+- `destroy` lets derived states (stoppable_state) live in the same block
+*/
+template <class T>
+class task_state : public task_node {
+    using value_type = std::conditional_t<std::is_void_v<T>, std::monostate, T>;
+
+    std::atomic<std::uint32_t> ready{0};
+    std::atomic<std::uint32_t> refs{2};
+    std::optional<value_type> value;
+    std::exception_ptr error;
+    void (*destroy)(task_state*) noexcept = &destroy_self;
+
+    friend class pool_future<T>;
+    friend class async_state<T>;
+
+    static void destroy_self(task_state* self) noexcept {
+        self->~task_state();
+        block_pool::deallocate(self, sizeof(task_state));
+    }
+
+    void set_ready() noexcept {
+        ready.store(1, std::memory_order_release);
+        ready.notify_all();
+    }
+
+protected:
+    template <class F, class... Args>
+    void invoke(F& f, Args&&... args) noexcept {
+        try {
+            if constexpr (std::is_void_v<T>) {
+                std::invoke(f, std::forward<Args>(args)...);
+                value.emplace();
+            }
+            else {
+                value.emplace(std::invoke(f, std::forward<Args>(args)...));
+            }
+        }
+        catch (...) {
+            error = std::current_exception();
+        }
+        set_ready();
+    }
+
+    void drop_ref() noexcept {
+        if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) destroy(this);
+    }
+
+    // after the task ran or was dropped by the pool, the state is ready then
+    void finish_queued() noexcept {
+        // destroy the captures now instead of when the last reference to the
+        // state goes away, which may be much later
+        fn.reset();
+        if (!ready.load(std::memory_order_relaxed)) {
+            // dropped by the pool without running
+            error = std::make_exception_ptr(std::future_error(std::future_errc::broken_promise));
+            set_ready();
+        }
+    }
+
+    static void release_queued(task_node* node) noexcept {
+        auto* self = static_cast<task_state*>(node);
+        self->finish_queued();
+        self->drop_ref();
+    }
+
+    explicit task_state(void (*d)(task_state*) noexcept = &destroy_self) : destroy(d) {
+        release = &release_queued;
+    }
+    ~task_state() = default;
+
+public:
+    // the lambda below captures `s` plus `f`, so callables up to 40 bytes
+    // stay inside the block
+    template <class F>
+    static task_state* create(F&& f) {
+        void* mem = block_pool::allocate(sizeof(task_state));
+        auto* s = ::new (mem) task_state();
+        try {
+            s->fn = unique_task([s, f = std::forward<F>(f)]() mutable { s->invoke(f); });
+        }
+        catch (...) {
+            s->~task_state();
+            block_pool::deallocate(mem, sizeof(task_state));
+            throw;
+        }
+        return s;
+    }
+};
+
+// move-only future of a task_state, get() rethrows the task's exception
+template <class T>
+class pool_future {
+protected:
+    task_state<T>* state = nullptr;
+public:
+    pool_future() noexcept = default;
+    explicit pool_future(task_state<T>* s) noexcept : state(s) {}
+    pool_future(pool_future&& other) noexcept : state(std::exchange(other.state, nullptr)) {}
+    pool_future& operator=(pool_future&& other) noexcept {
+        if (this != &other) {
+            if (state) state->drop_ref();
+            state = std::exchange(other.state, nullptr);
+        }
+        return *this;
+    }
+    ~pool_future() { if (state) state->drop_ref(); }
+
+    bool valid() const noexcept { return state != nullptr; }
+
+    bool is_ready() const noexcept {
+        return state->ready.load(std::memory_order_acquire);
+    }
+
+    void wait() const noexcept {
+        while (!state->ready.load(std::memory_order_acquire))
+            state->ready.wait(0, std::memory_order_acquire);
+    }
+
+    T get() {
+        wait();
+        struct drop_on_exit {
+            task_state<T>* s;
+            ~drop_on_exit() { s->drop_ref(); }
+        } guard{std::exchange(state, nullptr)};
+        if (guard.s->error) std::rethrow_exception(guard.s->error);
+        if constexpr (!std::is_void_v<T>) return std::move(*guard.s->value);
+    }
+};
+
+template <class T>
+class stoppable_future;
+
+/*
+task_state with an inplace_stop_source in the same pooled block, the task is
+invoked with a token of it, so cancelling a task allocates nothing; with a
+parent token the source is a child scope (see inplace_stop_token.hpp)
+*/
+template <class T>
+class stoppable_state final : public task_state<T> {
+    inplace_stop_source stop;
+
+    friend class stoppable_future<T>;
+
+    static void destroy_self(task_state<T>* base) noexcept {
+        auto* self = static_cast<stoppable_state*>(base);
+        self->~stoppable_state();
+        block_pool::deallocate(self, sizeof(stoppable_state));
+    }
+
+    explicit stoppable_state(inplace_stop_token parent) noexcept
+        : task_state<T>(&destroy_self), stop(parent) {}
+
+public:
+    template <class F>
+    static stoppable_state* create(F&& f, inplace_stop_token parent) {
+        void* mem = block_pool::allocate(sizeof(stoppable_state));
+        auto* s = ::new (mem) stoppable_state(parent);
+        try {
+            s->fn = unique_task([s, f = std::forward<F>(f)]() mutable {
+                s->invoke(f, s->stop.get_token());
+            });
+        }
+        catch (...) {
+            s->~stoppable_state();
+            block_pool::deallocate(mem, sizeof(stoppable_state));
+            throw;
+        }
+        return s;
+    }
+};
+
+// pool_future that can also cancel its task
+template <class T>
+class stoppable_future : public pool_future<T> {
+    stoppable_state<T>* stoppable() const noexcept {
+        return static_cast<stoppable_state<T>*>(this->state);
+    }
+public:
+    stoppable_future() noexcept = default;
+    explicit stoppable_future(stoppable_state<T>* s) noexcept : pool_future<T>(s) {}
+
+    // the task sees it through its token, a task still queued runs anyway
+    // and can return right away
+    bool request_stop() noexcept { return stoppable()->stop.request_stop(); }
+    inplace_stop_token get_stop_token() const noexcept { return stoppable()->stop.get_token(); }
+};
+
+// mutex-protected intrusive FIFO of task_nodes, push/pop never allocate
+class task_queue {
+    task_node* head = nullptr;
+    task_node* tail = nullptr;
+    std::mutex mut;
+    // written under the lock, read without it by size()
+    std::atomic<std::size_t> count{0};
+public:
+    task_queue() = default;
+    task_queue(task_queue const&) = delete;
+    task_queue& operator=(task_queue const&) = delete;
+
+    void push(task_node* node) {
+        node->next = nullptr;
+        std::scoped_lock lock(mut);
+        if (tail) tail->next = node;
+        else head = node;
+        tail = node;
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    task_node* try_pop() {
+        std::scoped_lock lock(mut);
+        task_node* node = head;
+        if (node) {
+            head = node->next;
+            if (!head) tail = nullptr;
+            count.store(count.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+        }
+        return node;
+    }
+
+    // approximate, for monitoring
+    std::size_t size() const noexcept { return count.load(std::memory_order_relaxed); }
+};
@@ -0,0 +1,712 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <stop_token>
+#include <chrono>
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <condition_variable>
+#include <mutex>
+#include <ranges>
+#include "work_stealing_queue.hpp"
+#include "event_count.hpp"
+#include "injection_queue.hpp"
+#include "task_node.hpp"
+#include "bulk_handle.hpp"
+#include "cpu_topology.hpp"
+#include "latency_histogram.hpp"
+#include "pool_stats.hpp"
+
+inline void cpu_relax() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// each priority has its own global queue and its own deque per worker,
+// workers drain higher lanes first
+enum class TaskPriority : std::uint8_t { interactive, normal, background };
+inline constexpr std::size_t numPriorities = 3;
+
+struct ThreadPoolOptions {
+    unsigned int numThreads = std::jthread::hardware_concurrency();
+    // pin worker i to the i-th allowed cpu (grouped by node, L3 and core)
+    // and steal from the closest workers first
+    bool pinWorkers = false;
+    // time one task out of this many for ThreadPoolStats::taskRunTime, 0
+    // disables the sampling
+    unsigned int runTimeSampleInterval = 64;
+    // start each steal scan at a random victim within every distance level,
+    // false scans in a fixed order
+    bool randomizeVictims = true;
+    // a successful steal moves up to half of the victim's lane, at most this
+    // many tasks, into the thief's deque; 1 steals a single task
+    unsigned int maxStealBatch = 32;
+    // elastic pool: start with numThreads workers and keep between
+    // minThreads and maxThreads of them, 0 means numThreads, so by default
+    // the pool is fixed; a worker is added when tasks stay queued for
+    // spawnDelay while no worker is parked, a worker parked for idleTimeout
+    // is retired
+    unsigned int minThreads = 0;
+    unsigned int maxThreads = 0;
+    std::chrono::milliseconds spawnDelay{10};
+    std::chrono::milliseconds idleTimeout{10'000};
+};
+
+class ThreadPool {
+    // deques hold pooled task_nodes or bare coroutine handles, see task_node.hpp
+    using TaskType = task_ref;
+    // one slot per possible worker, maxThreads of them; an elastic pool
+    // starts and retires workers in these slots but never resizes the
+    // vectors, thieves scan localQueues without synchronizing with the
+    // monitor, a reallocation would pull the deques out from under them
+    std::vector<std::jthread> threads;
+    // tasks submitted from outside, per lane, see injection_queue.hpp
+    static constexpr std::size_t maxInjectionShards = 16;
+    std::array<injection_queue, numPriorities> tasks;
+
+    // to reduce contention on the global work queue
+    using Lanes = std::array<work_stealing_queue<TaskType>, numPriorities>;
+    std::vector<Lanes> localQueues;
+
+    // tasks queued in the interactive and background lanes, so that empty
+    // lanes are skipped without scanning every victim; the normal lane carries
+    // most of the traffic and is always scanned instead of paying an RMW on a
+    // shared counter per task
+    struct alignas(std::hardware_destructive_interference_size) LaneCount {
+        std::atomic<std::int64_t> queued{0};
+    };
+    std::array<LaneCount, numPriorities> laneCounts;
+
+    // every starvationInterval-th pick a worker looks at the lanes from the
+    // lowest priority up, so background tasks progress under saturation
+    static constexpr unsigned starvationInterval = 32;
+    static constexpr std::array<TaskPriority, numPriorities> highFirst{
+        TaskPriority::interactive, TaskPriority::normal, TaskPriority::background};
+    static constexpr std::array<TaskPriority, numPriorities> lowFirst{
+        TaskPriority::background, TaskPriority::normal, TaskPriority::interactive};
+    // identify the current worker, see currentIndex()
+    inline static thread_local ThreadPool* owner = nullptr;
+    inline static thread_local unsigned int index = 0;
+    // picks the injection shard of a thread outside the pool
+    inline static thread_local std::size_t submitterKey =
+        std::hash<std::thread::id>{}(std::this_thread::get_id());
+
+    // idle workers spin for a while before parking on `parking`, submit
+    // wakes at most one of them
+    static constexpr unsigned spinRounds = 64;
+    event_count parking;
+
+    // written only by the owning worker, padded to avoid false sharing like
+    // the deques, see pool_stats.hpp
+    struct alignas(std::hardware_destructive_interference_size) WorkerStats {
+        stat_counter localPops;
+        stat_counter globalPops;
+        std::array<stat_counter, num_cpu_localities> steals;
+        stat_counter stolenTasks;
+        stat_counter failedSteals;
+        stat_counter tasksRun;
+        stat_counter spinningNs;
+        stat_counter parkedNs;
+        // time from enqueue() until a worker picked the task up, coroutines
+        // resumed through their handle carry no timestamp and aren't counted
+        std::array<latency_histogram, numPriorities> queueLatency;
+        latency_histogram runTime;
+        // scheduler state private to the worker lives here as well
+        unsigned int picks = 0;
+        std::uint64_t rng = 0;
+        // elastic pools only: when the worker parked, 0 while it is not,
+        // read by the monitor
+        std::atomic<std::int64_t> parkedSince{0};
+    };
+    std::vector<WorkerStats> workerStats;
+    unsigned int runTimeSampleInterval;
+    bool randomizeVictims;
+    unsigned int maxStealBatch;
+
+    // per worker: the other workers ordered by distance, SMT sibling first,
+    // then same L3, same node and remote; within a level the scan starts at a
+    // random victim, a fixed order would send every thief of a level to the
+    // same victim first and leave work on the others unstolen for longer
+    struct Victim {
+        unsigned int index;
+        cpu_locality level;
+        unsigned int levelEnd;  // one past the last victim at this level
+    };
+    std::vector<std::vector<Victim>> victims;
+    std::vector<int> workerCpus;    // -1 if not pinned
+    bool pinWorkers;
+
+    // elastic pools: the monitor thread is the only one starting and
+    // retiring workers, `live` is its own view of the slots
+    unsigned int minWorkers;
+    bool elastic;
+    std::vector<bool> live;
+    std::atomic<unsigned int> liveWorkers{0};
+    std::atomic<bool> shuttingDown{false};
+    std::jthread monitorThread;
+
+    void buildVictims(cpu_topology const& topo) {
+        unsigned int const n = localQueues.size();
+        auto const& cpus = topo.all();
+        workerCpus.assign(n, -1);
+        if (!cpus.empty()) {
+            for (unsigned int i = 0; i < n; ++i) workerCpus[i] = cpus[i % cpus.size()].id;
+        }
+        victims.resize(n);
+        for (unsigned int i = 0; i < n; ++i) {
+            for (unsigned int j = 0; j < n; ++j) {
+                if (j == i) continue;
+                cpu_locality level = cpu_locality::unknown;
+                if (!cpus.empty())
+                    level = cpu_topology::distance(cpus[i % cpus.size()], cpus[j % cpus.size()]);
+                victims[i].push_back({j, level, 0});
+            }
+            std::ranges::sort(victims[i], {}, [i, n](Victim const& v) {
+                return std::pair(v.level, (v.index + n - i) % n);
+            });
+            for (std::size_t k = victims[i].size(); k-- > 0;) {
+                bool const last = k + 1 == victims[i].size() || victims[i][k + 1].level != victims[i][k].level;
+                victims[i][k].levelEnd = last ? k + 1 : victims[i][k + 1].levelEnd;
+            }
+            // distinct nonzero xorshift seeds
+            workerStats[i].rng = 0x9E3779B97F4A7C15ull * (i + 1);
+        }
+    }
+
+    // xorshift64, the worker's own generator, a few cycles per steal scan
+    static std::uint64_t nextRandom(WorkerStats& w) noexcept {
+        std::uint64_t x = w.rng;
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        return w.rng = x;
+    }
+
+    // threads that are not workers of this pool get the number of slots
+    unsigned int currentIndex() const noexcept {
+        return owner == this ? index : localQueues.size();
+    }
+
+    static std::int64_t nowNs() noexcept {
+        return std::chrono::steady_clock::now().time_since_epoch().count();
+    }
+
+    // from outside the pool, `task` must be a task_node: the global queues
+    // link nodes through task_node::next
+    void enqueue(TaskType task, TaskPriority priority = TaskPriority::normal) {
+        auto const lane = static_cast<std::size_t>(priority);
+        if constexpr (threadPoolStats) {
+            if (auto* node = task.node()) node->enqueuedNs = nowNs();
+        }
+        if (priority != TaskPriority::normal)
+            laneCounts[lane].queued.fetch_add(1, std::memory_order_relaxed);
+        if (unsigned int i = currentIndex(); i == localQueues.size()) {
+            // currently on master thread, push to global queue
+            tasks[lane].push(task.node(), submitterKey);
+        }
+        else {
+            // push to local queue
+            localQueues[i][lane].push(task);
+        }
+        parking.notify_one();
+    }
+
+    // lazy binary splitting: keep the left half and push the right half,
+    // so the oldest (biggest) chunks sit at the top of the deque where
+    // thieves take them, and chunks are only split further on demand
+    template <class Body>
+    void runRange(Body* body, std::size_t b, std::size_t e) {
+        while (e - b > body->grain) {
+            std::size_t const mid = b + (e - b) / 2;
+            enqueue(make_task_node([this, body, mid, e] { runRange(body, mid, e); }));
+            e = mid;
+        }
+        if (!body->cancelled()) {
+            try {
+                for (std::size_t i = b; i != e; ++i) body->f(i);
+            }
+            catch (...) {
+                body->fail(std::current_exception());
+            }
+        }
+        body->complete(e - b);
+    }
+
+    // use work stealing to address problem of uneven distribution
+    TaskType tryStealTask(std::size_t lane) {
+        if (owner != this) {
+            for (auto& q : localQueues) {
+                if (auto task = q[lane].try_steal()) return task;
+            }
+            return {};
+        }
+        auto& stats = workerStats[index];
+        auto& mine = localQueues[index][lane];
+        auto const& vs = victims[index];
+        for (std::size_t b = 0; b < vs.size(); b = vs[b].levelEnd) {
+            std::size_t const len = vs[b].levelEnd - b;
+            std::size_t const start = randomizeVictims ? nextRandom(stats) % len : 0;
+            for (std::size_t k = 0; k < len; ++k) {
+                auto const& v = vs[b + (start + k) % len];
+                auto& q = localQueues[v.index][lane];
+                std::size_t taken;
+                if (auto task = q.steal_half(mine, maxStealBatch, taken)) {
+                    stats.steals[static_cast<std::size_t>(v.level)].add();
+                    stats.stolenTasks.add(taken);
+                    return task;
+                }
+                stats.failedSteals.add();
+            }
+        }
+        return {};
+    }
+
+    TaskType tryGetTask(TaskPriority priority) {
+        auto const lane = static_cast<std::size_t>(priority);
+        bool const counted = priority != TaskPriority::normal;
+        if (counted && laneCounts[lane].queued.load(std::memory_order_relaxed) <= 0)
+            return {};
+        bool const isWorker = owner == this;
+        TaskType task;
+        if (isWorker && (task = localQueues[index][lane].try_pop())) {
+            workerStats[index].localPops.add();
+        }
+        else if ((task = tasks[lane].try_pop(isWorker ? index : tasks[lane].home_of(submitterKey)))) {
+            if (isWorker) workerStats[index].globalPops.add();
+        }
+        else {
+            task = tryStealTask(lane);
+        }
+        if (task && counted) laneCounts[lane].queued.fetch_sub(1, std::memory_order_relaxed);
+        return task;
+    }
+
+    TaskType tryGetTask() {
+        if (owner != this) {
+            for (TaskPriority p : highFirst) {
+                if (auto task = tryGetTask(p)) return task;
+            }
+            return {};
+        }
+        auto& stats = workerStats[index];
+        auto const& order = ++stats.picks % starvationInterval == 0 ? lowFirst : highFirst;
+        for (TaskPriority p : order) {
+            if (auto task = tryGetTask(p)) {
+                if constexpr (threadPoolStats) {
+                    if (auto* node = task.node())
+                        stats.queueLatency[static_cast<std::size_t>(p)].record(nowNs() - node->enqueuedNs);
+                }
+                return task;
+            }
+        }
+        return {};
+    }
+
+    // worker only
+    void runTask(TaskType task) {
+        auto& stats = workerStats[index];
+        stats.tasksRun.add();
+        if constexpr (threadPoolStats) {
+            if (runTimeSampleInterval && stats.tasksRun.get() % runTimeSampleInterval == 0) {
+                auto const start = nowNs();
+                task.run();
+                stats.runTime.record(nowNs() - start);
+                return;
+            }
+        }
+        task.run();
+    }
+
+    // spin briefly since new work often arrives soon after the queues drain,
+    // then park until submit or the destructor wakes us up
+    void idle(std::stop_token const& st) {
+        auto& times = workerStats[index];
+        std::int64_t const spinStart = threadPoolStats ? nowNs() : 0;
+        TaskType task;
+        for (unsigned i = 0; i < spinRounds && !st.stop_requested(); ++i) {
+            if ((task = tryGetTask())) break;
+            cpu_relax();
+        }
+        std::int64_t const parkStart = threadPoolStats ? nowNs() : 0;
+        times.spinningNs.add(parkStart - spinStart);
+        if (!task && !st.stop_requested()) {
+            auto key = parking.prepare_wait();
+            // recheck after announcing ourselves as waiter, a task pushed
+            // before this point will be seen here, one pushed after will
+            // bump the epoch
+            if (st.stop_requested() || (task = tryGetTask())) {
+                parking.cancel_wait();
+            }
+            else {
+                if (elastic) times.parkedSince.store(nowNs(), std::memory_order_relaxed);
+                parking.wait(key);
+                if (elastic) times.parkedSince.store(0, std::memory_order_relaxed);
+                if constexpr (threadPoolStats) times.parkedNs.add(nowNs() - parkStart);
+            }
+        }
+        if (task) runTask(task);
+    }
+
+    void worker(std::stop_token st, unsigned int myIndex) {
+        owner = this;
+        index = myIndex;
+        if (pinWorkers && workerCpus[myIndex] >= 0) cpu_topology::pin_current_thread(workerCpus[myIndex]);
+        while (!st.stop_requested()) {
+            if (auto task = tryGetTask()) runTask(task);
+            else idle(st);
+        }
+        if (shuttingDown.load(std::memory_order_relaxed)) return;
+        // retired by the monitor, possibly right after a submit woke us up:
+        // run what is left in our deques (only we push to them, so they stay
+        // empty afterwards) and pass the wake-up on to another worker
+        for (bool ran = true; ran;) {
+            ran = false;
+            for (TaskPriority p : highFirst) {
+                auto const lane = static_cast<std::size_t>(p);
+                while (auto task = localQueues[index][lane].try_pop()) {
+                    if (p != TaskPriority::normal)
+                        laneCounts[lane].queued.fetch_sub(1, std::memory_order_relaxed);
+                    runTask(task);
+                    ran = true;
+                }
+            }
+        }
+        parking.notify_one();
+    }
+
+    // constructor and monitor only; a retired worker in the slot may still
+    // be finishing, assigning the jthread joins it first
+    void spawn(unsigned int i) {
+        threads[i] = std::jthread([this, i](std::stop_token st) { this->worker(st, i); });
+        live[i] = true;
+        liveWorkers.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // elastic pools: every spawnDelay, add a worker if tasks were queued at
+    // this and the previous check while no worker was parked (all of them
+    // are busy, or blocked), and retire one worker parked for idleTimeout;
+    // at most one of each per check, so the pool doesn't oscillate
+    void monitor(std::stop_token st, unsigned int maxWorkers,
+                 std::chrono::nanoseconds spawnDelay, std::chrono::nanoseconds idleTimeout) {
+        std::mutex mut;
+        std::condition_variable_any cv;
+        unsigned int busyChecks = 0;
+        std::unique_lock lock(mut);
+        while (!st.stop_requested()) {
+            cv.wait_for(lock, st, spawnDelay, [] { return false; });
+            if (st.stop_requested()) break;
+            std::int64_t const now = nowNs();
+            std::size_t queued = 0;
+            for (auto const& q : tasks) queued += q.size();
+            bool anyParked = false;
+            unsigned int idleWorker = 0, freeSlot = 0;
+            bool haveIdle = false, haveFree = false;
+            for (unsigned int i = 0; i < live.size(); ++i) {
+                if (!live[i]) {
+                    if (!haveFree) freeSlot = i, haveFree = true;
+                    continue;
+                }
+                for (auto const& q : localQueues[i]) queued += q.size();
+                if (auto since = workerStats[i].parkedSince.load(std::memory_order_relaxed)) {
+                    anyParked = true;
+                    // the highest one, so the pool shrinks towards slot 0
+                    if (now - since > idleTimeout.count()) idleWorker = i, haveIdle = true;
+                }
+            }
+            unsigned int const n = liveWorkers.load(std::memory_order_relaxed);
+            busyChecks = queued > 0 && !anyParked ? busyChecks + 1 : 0;
+            if (busyChecks >= 2 && n < maxWorkers && haveFree) {
+                spawn(freeSlot);
+            }
+            else if (haveIdle && n > minWorkers) {
+                live[idleWorker] = false;
+                liveWorkers.fetch_sub(1, std::memory_order_relaxed);
+                threads[idleWorker].request_stop();
+                parking.notify_all();
+            }
+        }
+    }
+public:
+    ThreadPool(unsigned int numThreads = std::jthread::hardware_concurrency())
+        : ThreadPool(ThreadPoolOptions{.numThreads = numThreads}) {}
+
+    explicit ThreadPool(ThreadPoolOptions const& options)
+        : threads(std::max({options.maxThreads, options.numThreads, 1u})),
+          tasks{injection_queue(std::min(threads.size(), maxInjectionShards)),
+                injection_queue(std::min(threads.size(), maxInjectionShards)),
+                injection_queue(std::min(threads.size(), maxInjectionShards))},
+          localQueues(threads.size()), workerStats(threads.size()),
+          runTimeSampleInterval(options.runTimeSampleInterval),
+          randomizeVictims(options.randomizeVictims),
+          maxStealBatch(std::max(options.maxStealBatch, 1u)),
+          pinWorkers(options.pinWorkers),
+          minWorkers(std::min(options.minThreads ? options.minThreads : options.numThreads,
+                              static_cast<unsigned int>(threads.size()))),
+          elastic(minWorkers < threads.size()),
+          live(threads.size(), false)
+    {
+        // without pinning a worker may run anywhere, so distances are unknown
+        buildVictims(options.pinWorkers ? cpu_topology::detect() : cpu_topology{});
+        unsigned int const maxWorkers = threads.size();
+        for (unsigned int i = 0; i < std::clamp(options.numThreads, minWorkers, maxWorkers); ++i)
+            spawn(i);
+        if (elastic) {
+            monitorThread = std::jthread([this, maxWorkers, options](std::stop_token st) {
+                this->monitor(st, maxWorkers, options.spawnDelay, options.idleTimeout);
+            });
+        }
+    }
+
+    ThreadPool(ThreadPool const&) = delete;
+    ThreadPool& operator=(ThreadPool const&) = delete;
+
+    ~ThreadPool() {
+        // no worker is started or retired from here on
+        monitorThread = {};
+        shuttingDown.store(true, std::memory_order_relaxed);
+        for (auto& thread : threads)
+            thread.request_stop();
+        // parked workers don't observe the stop token by themselves
+        parking.notify_all();
+        // join before localQueues and parking are destroyed
+        threads.clear();
+        // tasks that never ran break their promises
+        for (auto& lanes : localQueues) {
+            for (auto& q : lanes) {
+                while (auto task = q.try_pop()) task.discard();
+            }
+        }
+        // discarding may post continuations (async_future.hpp), they land in
+        // the global queues, drain until nothing comes back
+        for (bool found = true; found;) {
+            found = false;
+            for (auto& q : tasks) {
+                while (auto task = q.try_pop(0)) {
+                    task->discard();
+                    found = true;
+                }
+            }
+        }
+    }
+
+    // at most one allocation per task: the pooled task_state holds the
+    // callable (inline if small enough), the result and the queue link
+    template <std::invocable F>
+    auto submit(F&& f, TaskPriority priority = TaskPriority::normal)
+        -> pool_future<std::invoke_result_t<std::decay_t<F>&>> {
+        using Res = std::invoke_result_t<std::decay_t<F>&>;
+        auto* state = task_state<Res>::create(std::forward<F>(f));
+        enqueue(state, priority);
+        return pool_future<Res>(state);
+    }
+
+    // return future and stop_source so that user can wait for the task to
+    // complete or requesting stop for the task
+    template <std::invocable<std::stop_token> F>
+        requires (!std::invocable<F>)
+    auto submit(F&& f, TaskPriority priority = TaskPriority::normal)
+        -> std::pair<pool_future<std::invoke_result_t<std::decay_t<F>&, std::stop_token>>,
+                     std::stop_source> {
+        std::stop_source ssrc;
+        auto futRes = submit([f = std::forward<F>(f), st = ssrc.get_token()]() mutable {
+            return f(st);
+        }, priority);
+        return {std::move(futRes), std::move(ssrc)};
+    }
+
+    // f(inplace_stop_token): the stop source lives in the task's own block,
+    // so unlike the std::stop_token overload nothing extra is allocated;
+    // tasks submitted with the token of a scope (an inplace_stop_source) are
+    // all cancelled by scope.request_stop()
+    template <std::invocable<inplace_stop_token> F>
+        requires (!std::invocable<F> && !std::invocable<F, std::stop_token>)
+    auto submit(F&& f, inplace_stop_token scope, TaskPriority priority = TaskPriority::normal)
+        -> stoppable_future<std::invoke_result_t<std::decay_t<F>&, inplace_stop_token>> {
+        using Res = std::invoke_result_t<std::decay_t<F>&, inplace_stop_token>;
+        auto* state = stoppable_state<Res>::create(std::forward<F>(f), scope);
+        enqueue(state, priority);
+        return stoppable_future<Res>(state);
+    }
+
+    template <std::invocable<inplace_stop_token> F>
+        requires (!std::invocable<F> && !std::invocable<F, std::stop_token>)
+    auto submit(F&& f, TaskPriority priority = TaskPriority::normal) {
+        return submit(std::forward<F>(f), inplace_stop_token{}, priority);
+    }
+
+    // awaitable that moves the awaiting coroutine onto a worker:
+    //     co_await pool.schedule();
+    // always suspends, so on a worker it also acts as a yield; from a worker
+    // the bare handle goes to the local deque, from outside the awaiter's own
+    // task_node (it lives in the coroutine frame) goes to the global queue,
+    // neither allocates
+    class ScheduleAwaiter {
+        ThreadPool& pool;
+        TaskPriority priority;
+        task_node node;
+    public:
+        ScheduleAwaiter(ThreadPool& p, TaskPriority prio) noexcept : pool(p), priority(prio) {}
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) {
+            if (pool.currentIndex() != pool.localQueues.size()) {
+                pool.enqueue(task_ref(h), priority);
+                return;
+            }
+            node.fn = unique_task([h] { h.resume(); });
+            node.release = [](task_node*) noexcept {};
+            pool.enqueue(&node, priority);
+        }
+        void await_resume() const noexcept {}
+    };
+
+    ScheduleAwaiter schedule(TaskPriority priority = TaskPriority::normal) noexcept {
+        return {*this, priority};
+    }
+
+    // the pool whose worker is the calling thread, nullptr elsewhere
+    static ThreadPool* current() noexcept { return owner; }
+
+    // continuation stealing (fork_join.hpp): a worker pushes the coroutine
+    // that forks onto its own deque, where thieves find it, then runs the
+    // child, then takes the coroutine back if it is still on top; whoever
+    // pops or steals the handle resumes it. Both return false when not
+    // called from one of this pool's workers
+    bool push_continuation(std::coroutine_handle<> h) {
+        if (currentIndex() == localQueues.size()) return false;
+        enqueue(task_ref(h));
+        return true;
+    }
+
+    bool pop_continuation(std::coroutine_handle<> h) {
+        if (currentIndex() == localQueues.size()) return false;
+        auto& q = localQueues[index][static_cast<std::size_t>(TaskPriority::normal)];
+        task_ref const top = q.try_pop();
+        if (top == task_ref(h)) return true;
+        // something the child posted and left queued, h is below it
+        if (top) q.push(top);
+        return false;
+    }
+
+    // enqueue a task_node owned by the caller, for executors built on top of
+    // the pool (see task_graph.hpp), task->release is called after it ran
+    void post(task_node* task, TaskPriority priority = TaskPriority::normal) {
+        enqueue(task, priority);
+    }
+
+    // fire and forget: no future, no shared state, just the pooled node;
+    // like a std::thread function, f must not let an exception escape
+    template <class F>
+        requires std::invocable<std::decay_t<F>&>
+    void post(F&& f, TaskPriority priority = TaskPriority::normal) {
+        enqueue(make_task_node(std::forward<F>(f)), priority);
+    }
+
+    // run f(i) for i in [begin, end), chunks of at most `grain` iterations
+    // run without further splitting; the whole range is enqueued as a single
+    // task, so submitting from outside takes the global queue lock once
+    template <std::integral I, class F>
+        requires std::invocable<F const&, I>
+    bulk_handle parallel_for(I begin, I end, std::size_t grain, F&& f) {
+        std::size_t const n = begin < end ? static_cast<std::size_t>(end - begin) : 0;
+        auto loop = [begin, f = std::forward<F>(f)](std::size_t i) {
+            f(static_cast<I>(begin + i));
+        };
+        auto* body = bulk_body<decltype(loop)>::create(n, std::max<std::size_t>(grain, 1), std::move(loop));
+        bulk_handle res(body);
+        if (n != 0) enqueue(make_task_node([this, body, n] { runRange(body, 0, n); }));
+        return res;
+    }
+
+    // run f on every element of range, the range must outlive the handle
+    // becoming ready; grain 0 picks about 8 chunks per worker
+    template <std::ranges::random_access_range R, class F>
+        requires std::ranges::sized_range<R> &&
+                 std::invocable<F const&, std::ranges::range_reference_t<R>>
+    bulk_handle submit_bulk(R&& range, F&& f, std::size_t grain = 0) {
+        auto const n = static_cast<std::size_t>(std::ranges::size(range));
+        // an elastic pool may have no worker running
+        if (grain == 0) grain = n / (8 * std::max(numWorkers(), 1u));
+        return parallel_for(std::size_t{0}, n, grain,
+            [first = std::ranges::begin(range), f = std::forward<F>(f)](std::size_t i) {
+                f(first[i]);
+            });
+    }
+
+    // workers currently running, between minThreads and maxThreads
+    unsigned int numWorkers() const noexcept {
+        return liveWorkers.load(std::memory_order_relaxed);
+    }
+
+    // when tasks need to wait for other tasks, they can call this method
+    void runPendingTask() {
+        if (!tryRunPendingTask()) std::this_thread::yield();
+    }
+
+    // runs one queued task if there is any, for waits that block when not
+    bool tryRunPendingTask() {
+        auto task = tryGetTask();
+        if (!task) return false;
+        owner == this ? runTask(task) : task.run();
+        return true;
+    }
+
+    struct IdleStats {
+        std::chrono::nanoseconds spinning{0};
+        std::chrono::nanoseconds parked{0};
+    };
+
+    // total time all workers spent spinning vs parked while idle
+    IdleStats idleStats() const {
+        IdleStats res;
+        for (auto& t : workerStats) {
+            res.spinning += std::chrono::nanoseconds(t.spinningNs.get());
+            res.parked += std::chrono::nanoseconds(t.parkedNs.get());
+        }
+        return res;
+    }
+
+    // time tasks of the given lane spent queued before a worker picked them,
+    // e.g. queueLatency(TaskPriority::interactive).percentile(0.99)
+    latency_histogram::snapshot queueLatency(TaskPriority priority) const {
+        latency_histogram::snapshot res;
+        for (auto& w : workerStats)
+            w.queueLatency[static_cast<std::size_t>(priority)].add_to(res);
+        return res;
+    }
+
+    // successful steals by distance between thief and victim, indexed by
+    // cpu_locality; everything is `unknown` unless workers are pinned
+    std::array<std::uint64_t, num_cpu_localities> stealCounts() const {
+        std::array<std::uint64_t, num_cpu_localities> res{};
+        for (auto& w : workerStats) {
+            for (std::size_t i = 0; i < res.size(); ++i)
+                res[i] += w.steals[i].get();
+        }
+        return res;
+    }
+
+    // per-worker counters, all zero when built with THREAD_POOL_STATS=0
+    ThreadPoolStats stats() const {
+        ThreadPoolStats res;
+        res.workers.reserve(workerStats.size());
+        for (std::size_t i = 0; i < workerStats.size(); ++i) {
+            auto const& w = workerStats[i];
+            auto& out = res.workers.emplace_back();
+            out.localPops = w.localPops.get();
+            out.globalPops = w.globalPops.get();
+            for (std::size_t l = 0; l < num_cpu_localities; ++l) out.steals[l] = w.steals[l].get();
+            out.stolenTasks = w.stolenTasks.get();
+            out.failedSteals = w.failedSteals.get();
+            out.tasksRun = w.tasksRun.get();
+            for (auto const& q : localQueues[i]) out.queueDepth += q.size();
+            out.spinning = std::chrono::nanoseconds(w.spinningNs.get());
+            out.parked = std::chrono::nanoseconds(w.parkedNs.get());
+            w.runTime.add_to(res.taskRunTime);
+        }
+        return res;
+    }
+};
\ No newline at end of file
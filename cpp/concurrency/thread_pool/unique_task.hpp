@@ -0,0 +1,105 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/*
+Move-only type-erased `void()` callable with small buffer optimization
+- std::function requires a copyable target, so it cannot hold a
+  std::packaged_task or a lambda capturing a unique_ptr, and it allocates for
+  anything bigger than two pointers in libstdc++
+- unique_task is 64 bytes: 48 bytes of inline storage plus a pointer to a
+  static table of operations (see te_sbo.hpp for the same technique)
+- callables fall back to the heap if they are too big, over-aligned, or their
+  move constructor may throw (moving a unique_task must be noexcept so that it
+  can be relocated inside containers)
+*/
+class unique_task {
+public:
+    static constexpr std::size_t inline_size = 48;
+
+    unique_task() noexcept = default;
+
+    template <class F>
+        requires (!std::same_as<std::remove_cvref_t<F>, unique_task>) &&
+                 std::invocable<std::decay_t<F>&>
+    unique_task(F&& f) {
+        using Fn = std::decay_t<F>;
+        if constexpr (fits_inline<Fn>) {
+            ::new (static_cast<void*>(storage)) Fn(std::forward<F>(f));
+            vtbl = &inline_ops<Fn>;
+        }
+        else {
+            ::new (static_cast<void*>(storage)) Fn*(new Fn(std::forward<F>(f)));
+            vtbl = &heap_ops<Fn>;
+        }
+    }
+
+    unique_task(unique_task&& other) noexcept : vtbl(std::exchange(other.vtbl, nullptr)) {
+        if (vtbl) vtbl->relocate(storage, other.storage);
+    }
+
+    unique_task& operator=(unique_task&& other) noexcept {
+        if (this != &other) {
+            reset();
+            vtbl = std::exchange(other.vtbl, nullptr);
+            if (vtbl) vtbl->relocate(storage, other.storage);
+        }
+        return *this;
+    }
+
+    unique_task(unique_task const&) = delete;
+    unique_task& operator=(unique_task const&) = delete;
+
+    ~unique_task() { reset(); }
+
+    void operator()() { vtbl->invoke(storage); }
+
+    explicit operator bool() const noexcept { return vtbl != nullptr; }
+
+    void reset() noexcept {
+        if (vtbl) std::exchange(vtbl, nullptr)->destroy(storage);
+    }
+
+private:
+    struct ops {
+        void (*invoke)(void*);
+        // move-construct into dst and destroy src
+        void (*relocate)(void* dst, void* src) noexcept;
+        void (*destroy)(void*) noexcept;
+    };
+
+    template <class Fn>
+    static constexpr bool fits_inline =
+        sizeof(Fn) <= inline_size &&
+        alignof(Fn) <= alignof(std::max_align_t) &&
+        std::is_nothrow_move_constructible_v<Fn>;
+
+    template <class Fn>
+    static constexpr ops inline_ops{
+        [](void* p) { std::invoke(*std::launder(static_cast<Fn*>(p))); },
+        [](void* dst, void* src) noexcept {
+            Fn* from = std::launder(static_cast<Fn*>(src));
+            ::new (dst) Fn(std::move(*from));
+            from->~Fn();
+        },
+        [](void* p) noexcept { std::launder(static_cast<Fn*>(p))->~Fn(); }
+    };
+
+    // storage holds a Fn*
+    template <class Fn>
+    static constexpr ops heap_ops{
+        [](void* p) { std::invoke(**static_cast<Fn**>(p)); },
+        [](void* dst, void* src) noexcept {
+            ::new (dst) Fn*(*static_cast<Fn**>(src));
+        },
+        [](void* p) noexcept { delete *static_cast<Fn**>(p); }
+    };
+
+    alignas(std::max_align_t) std::byte storage[inline_size];
+    ops const* vtbl = nullptr;
+};
+
+static_assert(sizeof(unique_task) == 64);
@@ -0,0 +1,157 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+/*
+Lock-free, growable work-stealing deque (Chase-Lev)
+- Chase & Lev, "Dynamic Circular Work-Stealing Deque", SPAA 2005
+- memory orderings follow Le et al., "Correct and Efficient Work-Stealing for
+  Weak Memory Models", PPoPP 2013
+
+- owner thread: push and try_pop at the bottom (LIFO), no RMW on the fast path,
+  the only CAS happens when racing thieves for the very last item
+- thief threads: try_steal at the top (FIFO), one CAS on `top` per steal
+- slots only hold a pointer-sized handle (T{} means empty) so that a thief
+  racing with the owner only ever reads a single atomic word, the queue does
+  not own what the handles refer to
+*/
+template <class T>
+    requires std::is_trivially_copyable_v<T> && std::atomic<T>::is_always_lock_free
+class alignas(std::hardware_destructive_interference_size) work_stealing_queue {
+    struct circular_array {
+        std::int64_t capacity;      // always power of 2
+        std::unique_ptr<std::atomic<T>[]> slots;
+
+        explicit circular_array(std::int64_t cap)
+            : capacity(cap), slots(new std::atomic<T>[cap]) {}
+
+        T get(std::int64_t i) const noexcept {
+            return slots[i & (capacity - 1)].load(std::memory_order_relaxed);
+        }
+        void put(std::int64_t i, T task) noexcept {
+            slots[i & (capacity - 1)].store(task, std::memory_order_relaxed);
+        }
+
+        // only called by owner, [top, bottom) is copied to the new array
+        circular_array* grow(std::int64_t bottom, std::int64_t top) const {
+            auto* res = new circular_array(capacity * 2);
+            for (std::int64_t i = top; i != bottom; ++i) res->put(i, get(i));
+            return res;
+        }
+    };
+
+    alignas(std::hardware_destructive_interference_size) std::atomic<std::int64_t> top{0};
+    alignas(std::hardware_destructive_interference_size) std::atomic<std::int64_t> bottom{0};
+    std::atomic<circular_array*> array;
+
+    // a thief may still be reading the old array after grow, so retired arrays
+    // are kept until the queue is destroyed; since capacity doubles each time,
+    // the garbage is bounded by the size of the live array
+    std::vector<std::unique_ptr<circular_array>> garbage;
+
+public:
+    explicit work_stealing_queue(std::int64_t capacity = 256)
+        : array(new circular_array(capacity)) {}
+    work_stealing_queue(work_stealing_queue const&) = delete;
+    work_stealing_queue& operator=(work_stealing_queue const&) = delete;
+    ~work_stealing_queue() { delete array.load(std::memory_order_relaxed); }
+
+    // approximate, for monitoring
+    std::int64_t size() const noexcept {
+        std::int64_t const b = bottom.load(std::memory_order_relaxed);
+        std::int64_t const t = top.load(std::memory_order_relaxed);
+        return b > t ? b - t : 0;
+    }
+
+    // owner only
+    void push(T task) {
+        std::int64_t b = bottom.load(std::memory_order_relaxed);
+        std::int64_t t = top.load(std::memory_order_acquire);
+        circular_array* a = array.load(std::memory_order_relaxed);
+        if (b - t > a->capacity - 1) {
+            garbage.emplace_back(a);
+            a = a->grow(b, t);
+            array.store(a, std::memory_order_release);
+        }
+        a->put(b, task);
+        // publish the slot before thieves can observe the new bottom
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // owner only, pop at bottom, T{} if empty
+    T try_pop() {
+        std::int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        circular_array* a = array.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        // the store to bottom must be visible to thieves before we read top,
+        // otherwise both owner and a thief can take the last item
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t t = top.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            // empty
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return T{};
+        }
+        T task = a->get(b);
+        if (t == b) {
+            // last item, race against thieves
+            if (!top.compare_exchange_strong(t, t + 1,
+                    std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                task = T{};
+            }
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return task;
+    }
+
+    // any thread, steal at top, T{} if empty or lost the race
+    T try_steal() {
+        std::int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t b = bottom.load(std::memory_order_acquire);
+
+        if (t >= b) return T{};
+
+        circular_array* a = array.load(std::memory_order_acquire);
+        T task = a->get(t);
+        // lose to the owner or another thief, give up and let the caller move
+        // on to the next victim instead of retrying on a contended queue
+        if (!top.compare_exchange_strong(t, t + 1,
+                std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return T{};
+        }
+        return task;
+    }
+
+    /*
+    any thread: take up to half of the items (at most max_batch), return the
+    oldest one and push the others into `dst`, which the caller must own;
+    `taken` counts the returned task as well
+    - a thief that takes one task per steal under skewed load keeps coming
+      back to the same victim, moving half amortizes the victim scan
+    - the items are claimed one CAS at a time: a single CAS moving `top` by n
+      could overlap with items the owner pops meanwhile, since owner pops
+      don't CAS unless they are down to the last item
+    */
+    T steal_half(work_stealing_queue& dst, std::int64_t max_batch, std::size_t& taken) {
+        taken = 0;
+        T first = try_steal();
+        if (!first) return first;
+        taken = 1;
+        // half of the size before the first steal, rounded up
+        std::int64_t const n = std::min(max_batch, (size() + 2) / 2);
+        for (; static_cast<std::int64_t>(taken) < n; ++taken) {
+            T task = try_steal();
+            if (!task) break;
+            dst.push(task);
+        }
+        return first;
+    }
+};